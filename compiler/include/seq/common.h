@@ -99,6 +99,28 @@ inline llvm::Function *makeAllocFunc(llvm::Module *module, bool atomic) {
   return f;
 }
 
+// Pooled coroutine frame allocators:
+inline llvm::Function *makeCoroAllocFunc(llvm::Module *module) {
+  llvm::LLVMContext &context = module->getContext();
+  auto *f = llvm::cast<llvm::Function>(module->getOrInsertFunction(
+      "seq_coro_alloc", llvm::IntegerType::getInt8PtrTy(context),
+      seqIntLLVM(context)));
+  f->setDoesNotThrow();
+  f->setReturnDoesNotAlias();
+  f->setOnlyAccessesInaccessibleMemory();
+  return f;
+}
+
+inline llvm::Function *makeCoroFreeFunc(llvm::Module *module) {
+  llvm::LLVMContext &context = module->getContext();
+  auto *f = llvm::cast<llvm::Function>(module->getOrInsertFunction(
+      "seq_coro_free", llvm::Type::getVoidTy(context),
+      llvm::IntegerType::getInt8PtrTy(context)));
+  f->setDoesNotThrow();
+  f->setOnlyAccessesInaccessibleMemOrArgMem();
+  return f;
+}
+
 // Standard malloc:
 inline llvm::Function *makeMallocFunc(llvm::Module *module) {
   llvm::LLVMContext &context = module->getContext();
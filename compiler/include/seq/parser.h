@@ -5,6 +5,7 @@
 #include <caml/alloc.h>
 #include <caml/callback.h>
 #include <caml/mlvalues.h>
+#include <chrono>
 #include <iostream>
 #include <string>
 
@@ -24,11 +25,13 @@ value *init(bool repl) {
 }
 
 SeqModule *parse(const std::string &file) {
+  auto start = std::chrono::steady_clock::now();
   value *closure_f = init(false);
   try {
     auto *module = (SeqModule *)Nativeint_val(
         caml_callback(*closure_f, caml_copy_string(file.c_str())));
     module->setFileName(file);
+    reportStageTime("parse", start);
     return module;
   } catch (exc::SeqException &e) {
     compilationError(e.what(), e.getSrcInfo().file, e.getSrcInfo().line,
@@ -52,9 +55,10 @@ void execute(SeqModule *module, std::vector<std::string> args = {},
   }
 }
 
-void compile(SeqModule *module, const std::string &out, bool debug = false) {
+void compile(SeqModule *module, const std::string &out, bool debug = false,
+             OutputKind kind = BITCODE, std::vector<std::string> libs = {}) {
   try {
-    module->compile(out, debug);
+    module->compile(out, debug, kind, libs);
   } catch (exc::SeqException &e) {
     compilationError(e.what(), e.getSrcInfo().file, e.getSrcInfo().line,
                      e.getSrcInfo().col);
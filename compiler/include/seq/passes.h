@@ -0,0 +1,39 @@
+#ifndef SEQ_PASSES_H
+#define SEQ_PASSES_H
+
+#include "llvm.h"
+
+namespace seq {
+/**
+ * Creates a pass that replaces small, constant-size GC allocations (calls to
+ * seq_alloc and seq_alloc_atomic) with stack slots when the allocated object
+ * provably does not outlive the allocating function. This is most effective
+ * after inlining, when e.g. temporary class instances and tuples built by a
+ * callee are only used locally.
+ * @param report whether to print each converted allocation site to stderr
+ * @return new stack allocation pass
+ */
+llvm::FunctionPass *createStackAllocPass(bool report = false);
+
+/**
+ * Creates a pass that multiversions functions containing loops likely to be
+ * vectorized: each such function gets a baseline clone and a clone compiled
+ * for AVX2, and is itself replaced by a dispatcher that picks one at run time
+ * (via seq_cpu_has_avx2). Must run before vectorization, so that each clone
+ * is vectorized for its own target features.
+ * @return new multiversioning pass
+ */
+llvm::ModulePass *createMultiversionPass();
+
+/**
+ * Creates a pass that adds the number of llvm.coro.alloc calls in each
+ * function it runs on to the given counter. CoroElide folds these calls to
+ * false when it elides a coroutine frame, so instances run right before and
+ * right after it count the frames it elides.
+ * @param count counter to add to
+ * @return new counting pass
+ */
+llvm::FunctionPass *createCoroAllocCountPass(unsigned *count);
+} // namespace seq
+
+#endif /* SEQ_PASSES_H */
@@ -1,6 +1,7 @@
 #ifndef SEQ_SEQ_H
 #define SEQ_SEQ_H
 
+#include <chrono>
 #include <cstdint>
 #include <cstdlib>
 #include <map>
@@ -51,6 +52,11 @@ static ArrayType *Array = ArrayType::get();
 static GenType *Gen = GenType::get();
 } // namespace types
 
+/**
+ * Kinds of output that can be produced by SeqModule::compile().
+ */
+enum OutputKind { BITCODE, OBJECT, EXECUTABLE };
+
 /**
  * Top-level module representation for programs. All parsing, type checking
  * and code generation is initiated from this class.
@@ -73,7 +79,9 @@ public:
   void codegen(llvm::Module *module) override;
   void verify();
   void optimize(bool debug = false);
-  void compile(const std::string &out, bool debug = false);
+  void compile(const std::string &out, bool debug = false,
+               OutputKind kind = BITCODE,
+               const std::vector<std::string> &libs = {});
   void execute(const std::vector<std::string> &args = {},
                const std::vector<std::string> &libs = {}, bool debug = false);
 };
@@ -106,12 +114,25 @@ private:
   void exec(Func *func, std::unique_ptr<llvm::Module> module);
 
 public:
-  SeqJIT();
+  /**
+   * @param debug whether to compile functions in debug mode
+   */
+  explicit SeqJIT(bool debug = true);
   static void init();
   void addFunc(Func *func);
   void addExpr(Expr *expr, bool print = true);
   Var *addVar(Expr *expr);
   void delVar(Var *var);
+
+  /**
+   * Runs a whole program, whose functions are each optimized and compiled
+   * on their first call.
+   * @param module program module with a canonical main function
+   * @param args program arguments, including the program name
+   * @return exit status returned by main
+   */
+  int runMain(std::unique_ptr<llvm::Module> module,
+              const std::vector<std::string> &args);
 };
 #endif
 
@@ -121,6 +142,15 @@ void compilationError(const std::string &msg, const std::string &file = "",
 void compilationWarning(const std::string &msg, const std::string &file = "",
                         int line = 0, int col = 0);
 
+/**
+ * Prints the time elapsed since the given start time for a compilation stage
+ * to stderr, if stage timing was requested with -time-stages.
+ * @param stage name of the stage
+ * @param start time at which the stage started
+ */
+void reportStageTime(const std::string &stage,
+                     std::chrono::steady_clock::time_point start);
+
 } // namespace seq
 
 #endif /* SEQ_SEQ_H */
@@ -2031,6 +2031,20 @@ struct DrainState {
       : states(nullptr), filled(nullptr), type(nullptr), stages(), parallel() {}
 };
 
+#if SEQ_HAS_TAPIR
+// writes out the current thread's completed print lines (see seq_print), so
+// that output from parallel stages stays in program order
+static void flushLines(BasicBlock *block) {
+  LLVMContext &context = block->getContext();
+  Module *module = block->getModule();
+  auto *flushFunc = cast<Function>(module->getOrInsertFunction(
+      "seq_flush_lines", Type::getVoidTy(context)));
+  flushFunc->setDoesNotThrow();
+  IRBuilder<> builder(block);
+  builder.CreateCall(flushFunc);
+}
+#endif
+
 static Value *codegenPipe(BaseFunc *base,
                           Value *val,        // value of current pipeline output
                           types::Type *type, // type of current pipeline output
@@ -2187,6 +2201,10 @@ static Value *codegenPipe(BaseFunc *base,
      * Plain generator -- create implicit for-loop
      */
     Value *gen = val;
+#if SEQ_HAS_TAPIR
+    if (parallelize)
+      flushLines(block);
+#endif
     IRBuilder<> builder(block);
 
     BasicBlock *loop = BasicBlock::Create(context, "pipe", func);
@@ -2246,6 +2264,8 @@ static Value *codegenPipe(BaseFunc *base,
 
 #if SEQ_HAS_TAPIR
     if (parallelize) {
+      flushLines(block);
+      builder.SetInsertPoint(block);
       builder.CreateReattach(loop0, syncReg);
     } else {
 #endif
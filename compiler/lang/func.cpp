@@ -235,6 +235,9 @@ void Func::codegen(Module *module) {
    */
   Value *id = nullptr;
   if (gen) {
+    // frames can only be elided once the ramp is inlined into the caller
+    func->addFnAttr(Attribute::InlineHint);
+
     Function *idFn = Intrinsic::getDeclaration(module, Intrinsic::coro_id);
     Value *nullPtr =
         ConstantPointerNull::get(IntegerType::getInt8PtrTy(context));
@@ -273,7 +276,7 @@ void Func::codegen(Module *module) {
     Function *sizeFn = Intrinsic::getDeclaration(module, Intrinsic::coro_size,
                                                  {seqIntLLVM(context)});
     Value *size = builder.CreateCall(sizeFn);
-    auto *allocFunc = makeAllocFunc(module, false);
+    auto *allocFunc = makeCoroAllocFunc(module);
     alloc = builder.CreateCall(allocFunc, size);
   }
 
@@ -309,6 +312,7 @@ void Func::codegen(Module *module) {
     builder.CreateCondBr(needDynFree, dynFree, suspend);
 
     builder.SetInsertPoint(dynFree);
+    builder.CreateCall(makeCoroFreeFunc(module), mem);
     builder.CreateBr(suspend);
 
     builder.SetInsertPoint(suspend);
@@ -17,12 +17,23 @@ void Print::codegen0(BasicBlock *&block) {
   if (nopOnVoid && type->is(types::Void))
     return;
 
-  Value *str = type->strValue(val, block, getTryCatch());
-  auto *printFunc = cast<Function>(module->getOrInsertFunction(
-      "seq_print", Type::getVoidTy(context), types::Str->getLLVMType(context)));
+  // ints and floats are formatted straight into the runtime's output buffer
+  // rather than through a temporary string
+  std::string name = "seq_print";
+  types::Type *argType = types::Str;
+  if (type->is(types::Int) || type->is(types::Float)) {
+    name = type->is(types::Int) ? "seq_print_int" : "seq_print_float";
+    argType = type;
+  } else {
+    val = type->strValue(val, block, getTryCatch());
+  }
+
+  auto *printFunc = cast<Function>(
+      module->getOrInsertFunction(name, Type::getVoidTy(context),
+                                  argType->getLLVMType(context)));
   printFunc->setDoesNotThrow();
   IRBuilder<> builder(block);
-  builder.CreateCall(printFunc, str);
+  builder.CreateCall(printFunc, val);
 }
 
 Print *Print::clone(Generic *ref) {
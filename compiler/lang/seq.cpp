@@ -1,6 +1,21 @@
 #include "seq/seq.h"
+#include "seq/passes.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Transforms/Scalar.h"
+#include <algorithm>
 #include <cassert>
+#include <dlfcn.h>
 #include <iostream>
+#include <iterator>
 #include <memory>
 #include <system_error>
 
@@ -226,6 +241,11 @@ Function *SeqModule::makeCanonicalMainFunc(Function *realMain) {
 #endif
 
   builder.SetInsertPoint(exit);
+  // print output is buffered by the runtime; see seq_print
+  auto *flushFunc = cast<Function>(
+      module->getOrInsertFunction("seq_flush_all", Type::getVoidTy(context)));
+  flushFunc->setDoesNotThrow();
+  builder.CreateCall(flushFunc);
   builder.CreateRet(ConstantInt::get(LLVM_I32(), 0));
   return func;
 #undef LLVM_I32
@@ -284,7 +304,8 @@ void SeqModule::verify() { verifyModuleFailFast(*module); }
 
 static TargetMachine *getTargetMachine(Triple triple, StringRef cpuStr,
                                        StringRef featuresStr,
-                                       const TargetOptions &options) {
+                                       const TargetOptions &options,
+                                       Optional<Reloc::Model> relocModel) {
   std::string err;
   const Target *target = TargetRegistry::lookupTarget(MArch, triple, err);
 
@@ -292,11 +313,59 @@ static TargetMachine *getTargetMachine(Triple triple, StringRef cpuStr,
     return nullptr;
 
   return target->createTargetMachine(triple.getTriple(), cpuStr, featuresStr,
-                                     options, getRelocModel(), getCodeModel(),
+                                     options, relocModel, getCodeModel(),
                                      CodeGenOpt::Aggressive);
 }
 
-static void optimizeModule(Module *module, bool debug) {
+static cl::opt<bool>
+    stackAllocReport("stack-alloc-report",
+                     cl::desc("Report allocations moved to the stack"));
+
+static cl::opt<bool>
+    coroStats("coro-stats",
+              cl::desc("Report how many generator frames were elided"));
+
+// llvm.coro.alloc calls seen right before and right after CoroElide, for
+// -coro-stats
+static unsigned coroAllocsBeforeElide = 0;
+static unsigned coroAllocsAfterElide = 0;
+
+/*
+ * Code is generated for the CPU and features given by LLVM's -mcpu and -mattr
+ * (-mcpu=native meaning the host). Without -mcpu, the JIT targets the host,
+ * while compiled output stays generic so that it runs anywhere; functions in
+ * it with vectorizable loops are then multiversioned, getting an AVX2 clone
+ * that is picked at run time on CPUs supporting it. This happens once, in the
+ * second optimization round, after coroutines have been split.
+ */
+static cl::opt<bool>
+    multiversion("multiversion",
+                 cl::desc("Add AVX2 clones of functions with vectorizable "
+                          "loops to generic output (default: true)"),
+                 cl::init(true));
+
+/*
+ * Profile-guided optimization: -fprofile-generate instruments the program to
+ * write a raw profile on exit, which is then merged with llvm-profdata and
+ * passed back with -fprofile-use. Instrumentation and profile annotation
+ * happen only in the first optimization round, so that both see the same IR.
+ */
+static cl::opt<std::string> profileGenerate(
+    "fprofile-generate", cl::ValueOptional, cl::value_desc("file"),
+    cl::desc("Instrument the program to write an execution profile to the "
+             "given file on exit (default: default.profraw)"));
+
+static cl::opt<std::string>
+    profileUse("fprofile-use", cl::value_desc("file"),
+               cl::desc("Optimize using the given execution profile, as "
+                        "merged by llvm-profdata"));
+
+static bool profileGenerating() {
+  return profileGenerate.getNumOccurrences() > 0;
+}
+
+static void optimizeModule(Module *module, bool debug, bool pgo = false,
+                           bool clone = false) {
   std::unique_ptr<legacy::PassManager> pm(new legacy::PassManager());
   std::unique_ptr<legacy::FunctionPassManager> fpm(
       new legacy::FunctionPassManager(module));
@@ -311,7 +380,8 @@ static void optimizeModule(Module *module, bool debug) {
   if (moduleTriple.getArch()) {
     cpuStr = getCPUStr();
     featuresStr = getFeaturesStr();
-    machine = getTargetMachine(moduleTriple, cpuStr, featuresStr, options);
+    machine = getTargetMachine(moduleTriple, cpuStr, featuresStr, options,
+                               getRelocModel());
   }
 
   std::unique_ptr<TargetMachine> tm(machine);
@@ -345,10 +415,52 @@ static void optimizeModule(Module *module, bool debug) {
     builder.SLPVectorize = true;
   }
 
+  if (pgo && !debug) {
+    if (profileGenerating()) {
+      builder.EnablePGOInstrGen = true;
+      builder.PGOInstrGen = profileGenerate;
+    }
+    if (!profileUse.empty()) {
+      if (!sys::fs::exists(profileUse))
+        compilationError("could not open profile '" + profileUse + "'");
+      builder.PGOInstrUse = profileUse;
+    }
+  }
+
   if (tm)
     tm->adjustPassManager(builder);
 
+  if (!debug) {
+    // runs after inlining; SROA then promotes the new stack slots
+    builder.addExtension(
+        PassManagerBuilder::EP_ScalarOptimizerLate,
+        [](const PassManagerBuilder &, legacy::PassManagerBase &pm) {
+          pm.add(createStackAllocPass(stackAllocReport));
+          pm.add(createSROAPass());
+        });
+  }
+
+  if (clone && !debug && multiversion && cpuStr.empty())
+    builder.addExtension(
+        PassManagerBuilder::EP_VectorizerStart,
+        [](const PassManagerBuilder &, legacy::PassManagerBase &pm) {
+          pm.add(createMultiversionPass());
+        });
+
+  // extensions at the same point run in the order they were added
+  if (coroStats)
+    builder.addExtension(
+        PassManagerBuilder::EP_ScalarOptimizerLate,
+        [](const PassManagerBuilder &, legacy::PassManagerBase &pm) {
+          pm.add(createCoroAllocCountPass(&coroAllocsBeforeElide));
+        });
   addCoroutinePassesToExtensionPoints(builder);
+  if (coroStats)
+    builder.addExtension(
+        PassManagerBuilder::EP_ScalarOptimizerLate,
+        [](const PassManagerBuilder &, legacy::PassManagerBase &pm) {
+          pm.add(createCoroAllocCountPass(&coroAllocsAfterElide));
+        });
   builder.populateModulePassManager(*pm);
   builder.populateFunctionPassManager(*fpm);
 
@@ -359,15 +471,472 @@ static void optimizeModule(Module *module, bool debug) {
   pm->run(*module);
 }
 
-void SeqModule::optimize(bool debug) { optimizeModule(module, debug); }
+/*
+ * Generators are lowered to LLVM coroutines, and a coroutine's frame can only
+ * be elided (turning e.g. a for-loop over a generator into a plain loop) once
+ * its ramp function has been inlined into the caller. With nested generators,
+ * each run of the pipeline typically exposes one more level of this, so we
+ * keep re-running it for as long as heap-allocated frames keep disappearing.
+ */
+static const unsigned MAX_OPT_ROUNDS = 4;
+
+// number of call sites that allocate a coroutine frame on the heap
+static unsigned countCoroFrameAllocs(Module *module) {
+  Function *alloc = module->getFunction("seq_coro_alloc");
+  if (!alloc)
+    return 0;
+
+  unsigned count = 0;
+  for (User *user : alloc->users()) {
+    if (auto *call = dyn_cast<CallInst>(user)) {
+      if (call->getFunction())
+        ++count;
+    }
+  }
+  return count;
+}
+
+// number of call sites that create a generator, i.e. of calls to functions
+// which allocate a coroutine frame; only meaningful before optimization
+static unsigned countGeneratorCalls(Module *module) {
+  Function *alloc = module->getFunction("seq_coro_alloc");
+  if (!alloc)
+    return 0;
+
+  unsigned count = 0;
+  for (User *user : alloc->users()) {
+    auto *call = dyn_cast<CallInst>(user);
+    if (!call || !call->getFunction())
+      continue;
+    for (User *genUser : call->getFunction()->users()) {
+      if (isa<CallInst>(genUser) || isa<InvokeInst>(genUser))
+        ++count;
+    }
+  }
+  return count;
+}
+
+void SeqModule::optimize(bool debug) {
+  const unsigned generators = countGeneratorCalls(module);
+  unsigned allocs = countCoroFrameAllocs(module);
+  unsigned rounds = 0;
+  coroAllocsBeforeElide = coroAllocsAfterElide = 0;
+
+  while (true) {
+    optimizeModule(module, debug, rounds == 0, rounds == 1);
+    verify();
+    ++rounds;
+
+    const unsigned remaining = countCoroFrameAllocs(module);
+    const bool progress = remaining < allocs;
+    allocs = remaining;
+
+    // the second round is always run, since coroutines are split during the
+    // first one and can only be elided by a later one
+    if (rounds >= MAX_OPT_ROUNDS || (rounds >= 2 && (debug || !progress)))
+      break;
+  }
+
+  if (coroStats) {
+    errs() << "coroutines: " << generators << " generator call site(s), "
+           << (coroAllocsBeforeElide - coroAllocsAfterElide)
+           << " frame(s) elided, " << allocs
+           << " heap frame allocation(s) remaining after " << rounds
+           << " optimization round(s)\n";
+  }
+}
+
+static cl::opt<bool> timeStages(
+    "time-stages",
+    cl::desc("Report time spent parsing, generating code, optimizing and "
+             "compiling to machine code"));
+
+void seq::reportStageTime(const std::string &stage,
+                          std::chrono::steady_clock::time_point start) {
+  if (!timeStages)
+    return;
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  errs() << "time: " << format("%-9s", (stage + ":").c_str())
+         << format("%8.3f", elapsed.count()) << "s\n";
+}
+
+/*
+ * Compilation cache
+ *
+ * Optimized code is cached on disk, keyed by a hash of the unoptimized module
+ * and of everything else that affects optimization and code generation (Seq
+ * and LLVM versions, target triple, CPU and CPU features, relocation and code
+ * models, -multiversion and profiles). Runs given any other LLVM option, or
+ * asking for optimization reports, bypass the cache. The JIT stores
+ * object files (<key>.o) and compiling to a file stores optimized bitcode
+ * (<key>.bc), in SEQ_CACHE_DIR if set, or else $XDG_CACHE_HOME/seq or
+ * ~/.cache/seq. The key can only be computed once the program has been
+ * parsed and code-generated, so a hit saves optimization and, for the JIT,
+ * machine code generation. Entries are never evicted; the directory can be
+ * cleared at any time.
+ */
+static cl::opt<bool>
+    noCache("no-cache",
+            cl::desc("Do not use or update the compilation cache"));
+
+static void writeBitcode(Module *module, raw_ostream &out) {
+#if LLVM_VERSION_MAJOR >= 7
+  WriteBitcodeToFile(*module, out);
+#else
+  WriteBitcodeToFile(module, out);
+#endif
+}
+
+static std::string cacheDir() {
+  SmallString<128> dir;
+  if (const char *env = getenv("SEQ_CACHE_DIR")) {
+    dir = env;
+  } else if (const char *env = getenv("XDG_CACHE_HOME")) {
+    dir = env;
+    sys::path::append(dir, "seq");
+  } else if (sys::path::home_directory(dir)) {
+    sys::path::append(dir, ".cache", "seq");
+  } else {
+    return "";
+  }
+  return sys::fs::create_directories(dir) ? "" : dir.str().str();
+}
+
+// options that cachePath hashes, or that do not affect the generated code
+static const char *const CACHE_KEY_OPTIONS[] = {
+    "mcpu", "mattr", "relocation-model", "code-model", "multiversion",
+    "fprofile-generate", "fprofile-use", "lazy-jit", "o", "emit", "L", "d",
+    "no-cache", "time-stages"};
+
+// whether any other option, e.g. one of LLVM's many tuning flags, was given;
+// its value cannot be read generically, so such runs are not cached
+static bool hasUnkeyedOptions() {
+  for (auto &entry : cl::getRegisteredOptions()) {
+    if (entry.second->getNumOccurrences() == 0)
+      continue;
+    if (std::find(std::begin(CACHE_KEY_OPTIONS), std::end(CACHE_KEY_OPTIONS),
+                  entry.first()) == std::end(CACHE_KEY_OPTIONS))
+      return true;
+  }
+  return false;
+}
+
+// path of the cache entry for the given (unoptimized) module, or empty if
+// caching is disabled
+static std::string cachePath(Module *module, const std::string &ext) {
+  // reports are printed while optimizing, which a cache hit skips
+  if (noCache || stackAllocReport || coroStats || hasUnkeyedOptions())
+    return "";
+  std::string dir = cacheDir();
+  if (dir.empty())
+    return "";
+
+  SmallString<0> bitcode;
+  raw_svector_ostream stream(bitcode);
+  writeBitcode(module, stream);
+
+  MD5 hash;
+  hash.update(bitcode);
+  hash.update(std::to_string(SEQ_VERSION_MAJOR) + "." +
+              std::to_string(SEQ_VERSION_MINOR) + "." +
+              std::to_string(SEQ_VERSION_PATCH) + ";" LLVM_VERSION_STRING ";");
+  hash.update(module->getTargetTriple() + ";" + getCPUStr() + ";" +
+              getFeaturesStr() + ";");
+  Optional<Reloc::Model> relocModel = getRelocModel();
+  Optional<CodeModel::Model> codeModel = getCodeModel();
+  hash.update(
+      "reloc=" + (relocModel ? std::to_string(*relocModel) : "") +
+      ";code=" + (codeModel ? std::to_string(*codeModel) : "") +
+      ";multiversion=" + std::to_string(multiversion.getValue()) + ";");
+  if (profileGenerating())
+    hash.update("profile-generate=" + profileGenerate + ";");
+  if (!profileUse.empty()) {
+    if (auto profile = MemoryBuffer::getFile(profileUse))
+      hash.update((*profile)->getBuffer());
+  }
+  MD5::MD5Result result;
+  hash.final(result);
+  SmallString<32> key;
+  MD5::stringifyResult(result, key);
+
+  SmallString<128> path(dir);
+  sys::path::append(path, std::string(key.str()) + ext);
+  return path.str().str();
+}
+
+// writes via a temporary file so that concurrent runs never see partial
+// entries; failures only mean the entry is not cached
+static void storeInCache(const std::string &path, StringRef data) {
+  int fd;
+  SmallString<128> tmp;
+  if (sys::fs::createUniqueFile(path + ".tmp-%%%%%%%%", fd, tmp))
+    return;
+  {
+    raw_fd_ostream stream(fd, /*shouldClose=*/true);
+    stream << data;
+    stream.close();
+    if (stream.has_error()) {
+      stream.clear_error();
+      sys::fs::remove(tmp);
+      return;
+    }
+  }
+  if (sys::fs::rename(tmp, path))
+    sys::fs::remove(tmp);
+}
+
+/**
+ * Object cache for MCJIT with a single entry: the object for the one module
+ * being executed.
+ */
+class SeqObjectCache : public ObjectCache {
+private:
+  std::string path;
+
+public:
+  explicit SeqObjectCache(std::string path) : path(std::move(path)) {}
+
+  void notifyObjectCompiled(const Module *module,
+                            MemoryBufferRef obj) override {
+    storeInCache(path, obj.getBuffer());
+  }
+
+  std::unique_ptr<MemoryBuffer> getObject(const Module *module) override {
+    auto buf = MemoryBuffer::getFile(path);
+    if (!buf)
+      return nullptr;
+    return std::move(*buf);
+  }
+};
+
+/*
+ * Native code generation
+ *
+ * Besides bitcode, compile() can write a native object file or an executable
+ * linked against libseqrt and libgc by the system C compiler ($CC, or cc,
+ * clang or gcc). If the runtime was built with SEQ_RUNTIME_BITCODE, its
+ * bitcode (libseqrt.bc, next to libseqrt) is linked into the module for a
+ * final optimization round so that small runtime functions such as seq_alloc
+ * can be inlined. Their definitions are only made available for inlining:
+ * calls that are not inlined, and all of the runtime's global state, still
+ * resolve to libseqrt, so there is a single copy of that state. Functions that
+ * use static state of the runtime are left out entirely.
+ */
+static std::string runtimeDir() {
+  Dl_info info;
+  if (!dladdr((void *)seq_init, &info) || !info.dli_fname)
+    return "";
+  return sys::path::parent_path(info.dli_fname).str();
+}
+
+// whether 'value' refers to a global with local linkage, other than constant
+// data, which a copy of a runtime function outside of libseqrt cannot share
+static bool refersToRuntimeLocal(Value *value) {
+  if (auto *global = dyn_cast<GlobalValue>(value)) {
+    auto *var = dyn_cast<GlobalVariable>(global);
+    return global->hasLocalLinkage() &&
+           !(var && var->isConstant() && !var->isThreadLocal());
+  }
+  if (isa<Constant>(value)) {
+    for (Value *op : cast<Constant>(value)->operands()) {
+      if (refersToRuntimeLocal(op))
+        return true;
+    }
+  }
+  return false;
+}
+
+static bool refersToRuntimeLocal(Function &func) {
+  for (BasicBlock &block : func) {
+    for (Instruction &inst : block) {
+      for (Value *op : inst.operands()) {
+        if (refersToRuntimeLocal(op))
+          return true;
+      }
+    }
+  }
+  return false;
+}
+
+// returns whether any runtime bitcode was linked into the module
+static bool linkRuntimeBitcode(Module *module) {
+  SmallString<128> path(runtimeDir());
+  sys::path::append(path, "libseqrt.bc");
+  if (!sys::fs::exists(path))
+    return false;
+
+  SMDiagnostic diag;
+  std::unique_ptr<Module> runtime =
+      parseIRFile(path, diag, module->getContext());
+  if (!runtime) {
+    compilationWarning("could not load runtime bitcode: " +
+                       diag.getMessage().str());
+    return false;
+  }
+  runtime->setTargetTriple(module->getTargetTriple());
+  runtime->setDataLayout(module->getDataLayout());
+
+  for (Function &func : *runtime) {
+    if (func.isDeclaration() || !func.hasExternalLinkage())
+      continue;
+    if (refersToRuntimeLocal(func)) {
+      func.deleteBody();
+    } else {
+      func.setLinkage(GlobalValue::AvailableExternallyLinkage);
+      func.setComdat(nullptr);
+    }
+  }
+
+  for (GlobalVariable &var : runtime->globals()) {
+    if (var.isDeclaration() || !var.hasExternalLinkage())
+      continue;
+    var.setInitializer(nullptr);
+    var.setComdat(nullptr);
+  }
+
+  if (Linker::linkModules(*module, std::move(runtime),
+                          Linker::LinkOnlyNeeded)) {
+    compilationWarning("could not link runtime bitcode");
+    return false;
+  }
+  return true;
+}
 
-void SeqModule::compile(const std::string &out, bool debug) {
+static void emitObjectFile(Module *module, const std::string &path) {
+  Triple triple(module->getTargetTriple());
+  // position-independent by default, as most toolchains now link PIEs
+  Optional<Reloc::Model> relocModel = getRelocModel();
+  if (!relocModel.hasValue())
+    relocModel = Reloc::PIC_;
+  std::unique_ptr<TargetMachine> tm(
+      getTargetMachine(triple, getCPUStr(), getFeaturesStr(),
+                       InitTargetOptionsFromCodeGenFlags(), relocModel));
+  if (!tm)
+    compilationError("could not create target machine for " + triple.str());
+
+  legacy::PassManager pm;
+  TargetLibraryInfoImpl tlii(triple);
+  pm.add(new TargetLibraryInfoWrapperPass(tlii));
+
+  std::error_code err;
+  raw_fd_ostream stream(path, err, sys::fs::F_None);
+  if (err)
+    compilationError("could not open '" + path + "' for writing: " +
+                     err.message());
+
+#if LLVM_VERSION_MAJOR >= 7
+  if (tm->addPassesToEmitFile(pm, stream, nullptr,
+                              TargetMachine::CGFT_ObjectFile))
+#else
+  if (tm->addPassesToEmitFile(pm, stream, TargetMachine::CGFT_ObjectFile))
+#endif
+    compilationError("target does not support emitting object files");
+
+  pm.run(*module);
+}
+
+static int runProgram(const std::string &program,
+                      const std::vector<std::string> &args, std::string &err) {
+#if LLVM_VERSION_MAJOR >= 7
+  std::vector<StringRef> argRefs(args.begin(), args.end());
+  return sys::ExecuteAndWait(program, argRefs, None, {}, 0, 0, &err);
+#else
+  std::vector<const char *> argPtrs;
+  for (auto &arg : args)
+    argPtrs.push_back(arg.c_str());
+  argPtrs.push_back(nullptr);
+  return sys::ExecuteAndWait(program, argPtrs.data(), nullptr, {}, 0, 0,
+                             &err);
+#endif
+}
+
+static void linkExecutable(const std::string &obj, const std::string &out,
+                           const std::vector<std::string> &libs) {
+  std::string linker;
+  // instrumented code needs clang's profile runtime
+  std::vector<std::string> names = {"cc", "clang", "gcc"};
+  if (profileGenerating())
+    names = {"clang", "cc"};
+  if (const char *cc = getenv("CC"))
+    names = {cc};
+  for (auto &name : names) {
+    if (auto path = sys::findProgramByName(name)) {
+      linker = *path;
+      break;
+    }
+  }
+  if (linker.empty())
+    compilationError("could not find a C compiler to link with (set CC)");
+
+  std::vector<std::string> args = {linker, obj, "-o", out};
+  std::string dir = runtimeDir();
+  if (!dir.empty()) {
+    args.push_back("-L" + dir);
+    args.push_back("-Wl,-rpath," + dir);
+  }
+  args.push_back("-lseqrt");
+  // inlined runtime functions call the collector directly
+  args.push_back("-lgc");
+#if SEQ_HAS_TAPIR
+  // parallel loops are lowered to calls into libomp (__kmpc_*)
+  args.push_back("-lomp");
+#elif SEQ_THREADED
+  args.push_back("-fopenmp");
+#endif
+  args.insert(args.end(), libs.begin(), libs.end());
+  if (profileGenerating())
+    args.push_back("-fprofile-instr-generate");
+
+  std::string err;
+  int status = runProgram(linker, args, err);
+  if (status != 0)
+    compilationError("linking failed" + (err.empty() ? "" : ": " + err));
+}
+
+static void emitNative(Module *module, const std::string &out, OutputKind kind,
+                       const std::vector<std::string> &libs) {
+  if (kind == OBJECT) {
+    emitObjectFile(module, out);
+    return;
+  }
+
+  SmallString<128> obj;
+  if (sys::fs::createTemporaryFile("seq", "o", obj))
+    compilationError("could not create temporary object file");
+  emitObjectFile(module, obj.str().str());
+  linkExecutable(obj.str().str(), out, libs);
+  sys::fs::remove(obj);
+}
+
+void SeqModule::compile(const std::string &out, bool debug, OutputKind kind,
+                        const std::vector<std::string> &libs) {
+  auto start = std::chrono::steady_clock::now();
   codegen(module);
   verify();
+  reportStageTime("codegen", start);
+
+  start = std::chrono::steady_clock::now();
+  const std::string cached =
+      (debug || kind != BITCODE) ? "" : cachePath(module, ".bc");
+  if (!cached.empty() && sys::fs::exists(cached) &&
+      !sys::fs::copy_file(cached, out)) {
+    reportStageTime("cache", start);
+#if SEQ_HAS_TAPIR
+    resetOMPABI();
+#endif
+    module = nullptr;
+    return;
+  }
+
   optimize(debug);
-  verify();
-  optimize(debug);
-  verify();
+  // runtime functions are only brought in now, so that e.g. allocations are
+  // still recognizable as such by the passes above
+  if (kind != BITCODE && !debug && linkRuntimeBitcode(module)) {
+    optimizeModule(module, debug);
+    verify();
+  }
+  reportStageTime("optimize", start);
 
   if (debug)
     errs() << *module;
@@ -376,21 +945,30 @@ void SeqModule::compile(const std::string &out, bool debug) {
   resetOMPABI();
 #endif
 
-  std::error_code err;
-  raw_fd_ostream stream(out, err, llvm::sys::fs::F_None);
-
-#if LLVM_VERSION_MAJOR >= 7
-  WriteBitcodeToFile(*module, stream);
-#else
-  WriteBitcodeToFile(module, stream);
-#endif
+  if (kind != BITCODE) {
+    start = std::chrono::steady_clock::now();
+    emitNative(module, out, kind, libs);
+    reportStageTime("native", start);
+    module = nullptr;
+    return;
+  }
 
+  SmallString<0> bitcode;
+  raw_svector_ostream bitcodeStream(bitcode);
+  writeBitcode(module, bitcodeStream);
   module = nullptr;
 
+  std::error_code err;
+  raw_fd_ostream stream(out, err, llvm::sys::fs::F_None);
+  stream << bitcode;
+
   if (err) {
     std::cerr << "error: " << err.message() << std::endl;
     exit(err.value());
   }
+
+  if (!cached.empty())
+    storeInCache(cached, bitcode);
 }
 
 extern "C" void seq_gc_add_roots(void *start, void *end);
@@ -427,14 +1005,81 @@ public:
   }
 };
 
+static void loadLibraries(const std::vector<std::string> &libs) {
+  std::string err;
+  for (auto &lib : libs) {
+    if (sys::DynamicLibrary::LoadLibraryPermanently(lib.c_str(), &err)) {
+      std::cerr << "error: " << err << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+#if LLVM_VERSION_MAJOR == 6
+static cl::opt<bool>
+    lazyJIT("lazy-jit",
+            cl::desc("Optimize and compile each function on its first call "
+                     "when running a program, for faster startup"));
+#endif
+
 void SeqModule::execute(const std::vector<std::string> &args,
                         const std::vector<std::string> &libs, bool debug) {
+  // JIT-compiled code cannot register with the profile runtime, so an
+  // instrumented executable is built and run instead
+  if (profileGenerating() && !debug) {
+    SmallString<128> exe;
+    if (sys::fs::createTemporaryFile("seq", "", exe))
+      compilationError("could not create temporary executable");
+    compile(exe.str().str(), debug, EXECUTABLE, libs);
+
+    std::vector<std::string> exeArgs(args);
+    if (exeArgs.empty())
+      exeArgs.push_back(exe.str().str());
+    std::string err;
+    int status = runProgram(exe.str().str(), exeArgs, err);
+    sys::fs::remove(exe);
+    if (status < 0)
+      compilationError("could not run instrumented program: " + err);
+    if (status != 0)
+      exit(status);
+    return;
+  }
+
+  if (MCPU.getNumOccurrences() == 0)
+    MCPU = "native";
+
+  auto start = std::chrono::steady_clock::now();
   codegen(module);
   verify();
-  optimize(debug);
-  verify();
-  optimize(debug);
-  verify();
+  reportStageTime("codegen", start);
+
+#if LLVM_VERSION_MAJOR == 6
+  // startup then does not pay for code that never runs (e.g. unused stdlib
+  // specializations), at the price of no inlining across functions
+  if (lazyJIT && !debug) {
+#if SEQ_HAS_TAPIR
+    resetOMPABI();
+#endif
+    loadLibraries(libs);
+    std::unique_ptr<Module> owner(module);
+    module = nullptr;
+    SeqJIT jit(debug);
+    jit.runMain(std::move(owner), args);
+    return;
+  }
+#endif
+
+  // on a cache hit, MCJIT loads the cached object instead of compiling the
+  // (unoptimized) module, so optimization can be skipped as well
+  start = std::chrono::steady_clock::now();
+  const std::string cached = debug ? "" : cachePath(module, ".o");
+  const bool hit = !cached.empty() && sys::fs::exists(cached);
+  if (!hit) {
+    optimize(debug);
+    reportStageTime("optimize", start);
+  } else {
+    reportStageTime("cache", start);
+  }
 
   if (debug)
     errs() << *module;
@@ -448,20 +1093,27 @@ void SeqModule::execute(const std::vector<std::string> &args,
   EngineBuilder EB(std::move(owner));
   EB.setMCJITMemoryManager(make_unique<BoehmGCMemoryManager>());
   EB.setUseOrcMCJITReplacement(true);
+  SmallVector<StringRef, 16> features;
+  StringRef(getFeaturesStr()).split(features, ',', -1, false);
+  EB.setMCPU(getCPUStr());
+  EB.setMAttrs(features);
   ExecutionEngine *eng = EB.create();
+  std::unique_ptr<SeqObjectCache> cache;
+  if (!cached.empty()) {
+    cache = make_unique<SeqObjectCache>(cached);
+    eng->setObjectCache(cache.get());
+  }
 
   assert(initFunc);
   assert(strlenFunc);
   eng->addGlobalMapping(initFunc, (void *)seq_init);
   eng->addGlobalMapping(strlenFunc, (void *)strlen);
 
-  std::string err;
-  for (auto &lib : libs) {
-    if (sys::DynamicLibrary::LoadLibraryPermanently(lib.c_str(), &err)) {
-      std::cerr << "error: " << err << std::endl;
-      exit(EXIT_FAILURE);
-    }
-  }
+  loadLibraries(libs);
+
+  start = std::chrono::steady_clock::now();
+  eng->getPointerToFunction(func);
+  reportStageTime("jit", start);
 
   eng->runFunctionAsMain(func, args, nullptr);
 }
@@ -477,14 +1129,14 @@ static std::shared_ptr<Module> optimizeModule(std::shared_ptr<Module> module,
   return module;
 }
 
-SeqJIT::SeqJIT()
+SeqJIT::SeqJIT(bool debug)
     : target(EngineBuilder().selectTarget()),
       layout(target->createDataLayout()),
       objLayer([]() { return std::make_shared<BoehmGCMemoryManager>(); }),
       comLayer(objLayer, SimpleCompiler(*target)),
       optLayer(comLayer,
-               [](std::shared_ptr<Module> M) {
-                 return optimizeModule(std::move(M), true);
+               [debug](std::shared_ptr<Module> M) {
+                 return optimizeModule(std::move(M), debug);
                }),
       callbackManager(
           orc::createLocalCompileCallbackManager(target->getTargetTriple(), 0)),
@@ -535,6 +1187,19 @@ void SeqJIT::removeModule(SeqJIT::ModuleHandle handle) {
   cantFail(codLayer.removeModule(handle));
 }
 
+int SeqJIT::runMain(std::unique_ptr<Module> module,
+                    const std::vector<std::string> &args) {
+  addModule(std::move(module));
+  auto sym = findSymbol("main");
+  auto *main = (int (*)(int, char **))cantFail(sym.getAddress());
+
+  std::vector<char *> argv;
+  for (auto &arg : args)
+    argv.push_back(const_cast<char *>(arg.c_str()));
+  argv.push_back(nullptr);
+  return main((int)args.size(), argv.data());
+}
+
 Func SeqJIT::makeFunc() {
   Func func;
   func.setName("seq.repl.input." + std::to_string(inputNum));
@@ -567,6 +1232,7 @@ void SeqJIT::exec(Func *func, std::unique_ptr<Module> module) {
   auto sym = findSymbol(func->genericName());
   void (*fn)() = (void (*)())cantFail(sym.getAddress());
   fn();
+  seq_flush_all();
 }
 
 void SeqJIT::addFunc(Func *func) {
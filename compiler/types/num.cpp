@@ -154,6 +154,17 @@ void types::IntType::initOps() {
        },
        false},
 
+      {"__popcnt__",
+       {},
+       Int,
+       [](Value *self, std::vector<Value *> args, IRBuilder<> &b) {
+         Function *popcnt = Intrinsic::getDeclaration(
+             b.GetInsertBlock()->getModule(), Intrinsic::ctpop,
+             {seqIntLLVM(b.getContext())});
+         return b.CreateCall(popcnt, self);
+       },
+       false},
+
       {"__abs__",
        {},
        Int,
@@ -608,6 +619,18 @@ void types::IntNType::initOps() {
        },
        false},
 
+      {"__popcnt__",
+       {},
+       Int,
+       [this](Value *self, std::vector<Value *> args, IRBuilder<> &b) {
+         Function *popcnt = Intrinsic::getDeclaration(
+             b.GetInsertBlock()->getModule(), Intrinsic::ctpop,
+             {getLLVMType(b.getContext())});
+         Value *result = b.CreateCall(popcnt, self);
+         return b.CreateZExtOrTrunc(result, seqIntLLVM(b.getContext()));
+       },
+       false},
+
       // int,int binary
       {"__add__",
        {this},
@@ -12,6 +12,25 @@ Value *types::PtrType::defaultValue(BasicBlock *block) {
       PointerType::get(getBaseType(0)->getLLVMType(context), 0));
 }
 
+/*
+ * Atomic operations are sequentially consistent, like those of AtomicExpr,
+ * and only supported on integer and pointer base types.
+ */
+static Value *atomicTarget(Value *self, bool integerOnly) {
+  llvm::Type *type = self->getType()->getPointerElementType();
+  if (!(type->isIntegerTy() || (!integerOnly && type->isPointerTy())))
+    throw exc::SeqException("atomic operation on unsupported pointer type");
+  return self;
+}
+
+static unsigned atomicAlignment(Value *self, IRBuilder<> &b) {
+  llvm::Type *type = self->getType()->getPointerElementType();
+  return (unsigned)b.GetInsertBlock()
+      ->getModule()
+      ->getDataLayout()
+      .getTypeStoreSize(type);
+}
+
 void types::PtrType::initOps() {
   if (!vtable.magic.empty())
     return;
@@ -158,6 +177,63 @@ void types::PtrType::initOps() {
        },
        false},
 
+      {"__atomic_load__",
+       {},
+       getBaseType(0),
+       [](Value *self, std::vector<Value *> args, IRBuilder<> &b) {
+         LoadInst *load = b.CreateLoad(atomicTarget(self, false));
+         load->setAlignment(atomicAlignment(self, b));
+         load->setAtomic(AtomicOrdering::SequentiallyConsistent);
+         return load;
+       },
+       false},
+
+      {"__atomic_store__",
+       {getBaseType(0)},
+       Void,
+       [](Value *self, std::vector<Value *> args, IRBuilder<> &b) {
+         StoreInst *store = b.CreateStore(args[0], atomicTarget(self, false));
+         store->setAlignment(atomicAlignment(self, b));
+         store->setAtomic(AtomicOrdering::SequentiallyConsistent);
+         return (Value *)nullptr;
+       },
+       false},
+
+      {"__atomic_xchg__",
+       {getBaseType(0)},
+       getBaseType(0),
+       [](Value *self, std::vector<Value *> args, IRBuilder<> &b) {
+         return b.CreateAtomicRMW(AtomicRMWInst::BinOp::Xchg,
+                                  atomicTarget(self, true), args[0],
+                                  AtomicOrdering::SequentiallyConsistent);
+       },
+       false},
+
+      {"__atomic_xadd__",
+       {getBaseType(0)},
+       getBaseType(0),
+       [](Value *self, std::vector<Value *> args, IRBuilder<> &b) {
+         return b.CreateAtomicRMW(AtomicRMWInst::BinOp::Add,
+                                  atomicTarget(self, true), args[0],
+                                  AtomicOrdering::SequentiallyConsistent);
+       },
+       false},
+
+      // compare-and-swap: stores the second argument if the pointee equals
+      // the first, returning whether it did
+      {"__atomic_cas__",
+       {getBaseType(0), getBaseType(0)},
+       Bool,
+       [](Value *self, std::vector<Value *> args, IRBuilder<> &b) {
+         Value *pair = b.CreateAtomicCmpXchg(
+             atomicTarget(self, false), args[0], args[1],
+             AtomicOrdering::SequentiallyConsistent,
+             AtomicOrdering::SequentiallyConsistent);
+         return b.CreateZExt(b.CreateExtractValue(pair, 1),
+                             Bool->getLLVMType(b.getContext()));
+       },
+       false},
+
       /*
        * Prefetch magics are labeled [rw][0123] representing read/write and
        * locality. Instruction cache prefetch is not supported.
@@ -267,6 +267,22 @@ getRevCompTable(Module *module, const std::string &name = "seq.revcomp_table") {
   return table;
 }
 
+/*
+ * Multi-word k-mers (k > 32) are represented as i(2k), which is generally not a
+ * legal integer width. LLVM legalizes such values by promoting them to the next
+ * multiple of 64 bits and re-masking the unused high bits after most
+ * operations, which is costly in hot loops. The helpers below let us instead
+ * operate on whole 64-bit words and truncate back to i(2k) only once.
+ */
+static unsigned kmerWordBits(unsigned k) {
+  const unsigned bits = 2 * k;
+  return bits <= 64 ? bits : ((bits + 63) / 64) * 64;
+}
+
+static Type *kmerWordType(types::KMer *kmerType, LLVMContext &context) {
+  return IntegerType::getIntNTy(context, kmerWordBits(kmerType->getK()));
+}
+
 /*
  * Here we create functions for k-mer sliding window shifts. For example, if
  * some k-mer represents a portion of a longer read, we can "shift in" the next
@@ -298,11 +314,17 @@ static Function *getShiftFunc(types::KMer *kmerType, Module *module, bool dir) {
     /*
      * The following function is just a for-loop that continually shifts in
      * new bases from the given sequences into the k-mer, then returns it.
+     *
+     * The loop operates on whole words (see kmerWordType()): left slides only
+     * push junk into the unused high bits, which are dropped by the final
+     * truncation, and right slides never introduce any.
      */
     BasicBlock *entry = BasicBlock::Create(context, "entry", func);
     Value *ptr = types::Seq->memb(seq, "ptr", entry);
     Value *len = types::Seq->memb(seq, "len", entry);
     IRBuilder<> builder(entry);
+    Type *wordType = kmerWordType(kmerType, context);
+    kmer = builder.CreateZExt(kmer, wordType);
     Value *rc = builder.CreateICmpSLT(len, zeroLLVM(context));
     len = builder.CreateSelect(rc, builder.CreateNeg(len), len);
 
@@ -311,7 +333,7 @@ static Function *getShiftFunc(types::KMer *kmerType, Module *module, bool dir) {
     builder.SetInsertPoint(loop);
 
     PHINode *control = builder.CreatePHI(seqIntLLVM(context), 2);
-    PHINode *result = builder.CreatePHI(kmerType->getLLVMType(context), 2);
+    PHINode *result = builder.CreatePHI(wordType, 2);
     control->addIncoming(zeroLLVM(context), entry);
     result->addIncoming(kmer, entry);
     Value *cond = builder.CreateICmpSLT(control, len);
@@ -338,7 +360,7 @@ static Function *getShiftFunc(types::KMer *kmerType, Module *module, bool dir) {
       Value *bits = builder.CreateLoad(
           builder.CreateInBoundsGEP(table, {builder.getInt64(0), base}));
       bits = builder.CreateSelect(rc, builder.CreateNot(bits), bits);
-      bits = builder.CreateZExt(bits, kmerType->getLLVMType(context));
+      bits = builder.CreateZExt(bits, wordType);
       bits = builder.CreateShl(bits, 2 * (kmerType->getK() - 1));
       kmerMod = builder.CreateOr(kmerMod, bits);
     } else {
@@ -354,7 +376,7 @@ static Function *getShiftFunc(types::KMer *kmerType, Module *module, bool dir) {
       Value *bits = builder.CreateLoad(
           builder.CreateInBoundsGEP(table, {builder.getInt64(0), base}));
       bits = builder.CreateSelect(rc, builder.CreateNot(bits), bits);
-      bits = builder.CreateZExt(bits, kmerType->getLLVMType(context));
+      bits = builder.CreateZExt(bits, wordType);
       kmerMod = builder.CreateOr(kmerMod, bits);
     }
 
@@ -366,7 +388,52 @@ static Function *getShiftFunc(types::KMer *kmerType, Module *module, bool dir) {
     BasicBlock *exit = BasicBlock::Create(context, "exit", func);
     branch->setSuccessor(1, exit);
     builder.SetInsertPoint(exit);
-    builder.CreateRet(result);
+    builder.CreateRet(
+        builder.CreateTrunc(result, kmerType->getLLVMType(context)));
+  }
+
+  return func;
+}
+
+/*
+ * Hash function for multi-word k-mers (k > 32). Every 64-bit word of the k-mer
+ * is folded into the hash with a multiply-xorshift step, followed by the
+ * MurmurHash3 finalizer, so that bases in all positions affect all hash bits.
+ */
+static Function *getHashFunc(types::KMer *kmerType, Module *module) {
+  const std::string name = "seq." + kmerType->getName() + ".hash";
+  LLVMContext &context = module->getContext();
+  Function *func = module->getFunction(name);
+
+  if (!func) {
+    func = cast<Function>(module->getOrInsertFunction(
+        name, seqIntLLVM(context), kmerType->getLLVMType(context)));
+    func->setDoesNotThrow();
+    func->setLinkage(GlobalValue::PrivateLinkage);
+    func->addFnAttr(Attribute::AlwaysInline);
+
+    Value *kmer = func->arg_begin();
+    BasicBlock *block = BasicBlock::Create(context, "entry", func);
+    IRBuilder<> builder(block);
+
+    const unsigned bits = kmerWordBits(kmerType->getK());
+    Value *wide = builder.CreateZExt(kmer, kmerWordType(kmerType, context));
+    Value *hash = builder.getInt64(kmerType->getK());
+
+    for (unsigned i = 0; i < bits / 64; i++) {
+      Value *word = builder.CreateLShr(wide, 64 * i);
+      word = builder.CreateTrunc(word, builder.getInt64Ty());
+      hash = builder.CreateXor(hash, word);
+      hash = builder.CreateMul(hash, builder.getInt64(0x9e3779b97f4a7c15ull));
+      hash = builder.CreateXor(hash, builder.CreateLShr(hash, 32));
+    }
+
+    hash = builder.CreateXor(hash, builder.CreateLShr(hash, 33));
+    hash = builder.CreateMul(hash, builder.getInt64(0xff51afd7ed558ccdull));
+    hash = builder.CreateXor(hash, builder.CreateLShr(hash, 33));
+    hash = builder.CreateMul(hash, builder.getInt64(0xc4ceb9fe1a85ec53ull));
+    hash = builder.CreateXor(hash, builder.CreateLShr(hash, 33));
+    builder.CreateRet(builder.CreateZExtOrTrunc(hash, seqIntLLVM(context)));
   }
 
   return func;
@@ -687,14 +754,12 @@ void types::KMer::initOps() {
        {},
        Int,
        [this](Value *self, std::vector<Value *> args, IRBuilder<> &b) {
-         Value *hash = b.CreateZExtOrTrunc(self, seqIntLLVM(b.getContext()));
-         if (getK() > 32) {
-           // make sure bases on both ends are involved in hash:
-           Value *aux = b.CreateLShr(self, 2 * getK() - 64);
-           aux = b.CreateZExtOrTrunc(aux, seqIntLLVM(b.getContext()));
-           hash = b.CreateXor(hash, aux);
-         }
-         return hash;
+         if (getK() <= 32)
+           return b.CreateZExtOrTrunc(self, seqIntLLVM(b.getContext()));
+
+         // make sure bases in every word are involved in hash:
+         Module *module = b.GetInsertBlock()->getModule();
+         return (Value *)b.CreateCall(getHashFunc(this, module), self);
        },
        false},
 
@@ -760,6 +825,15 @@ void types::KMer::initOps() {
        },
        false},
 
+      // unsigned integer with the same order as k-mers (see radix_sort)
+      {"__radix_key__",
+       {},
+       iType,
+       [iType](Value *self, std::vector<Value *> args, IRBuilder<> &b) {
+         return b.CreateBitCast(self, iType->getLLVMType(b.getContext()));
+       },
+       false},
+
       {"__pickle__",
        {PtrType::get(Byte)},
        Void,
@@ -0,0 +1,311 @@
+#include "seq/passes.h"
+#include "llvm/Analysis/CaptureTracking.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+const uint64_t MAX_STACK_ALLOC = 512;  // largest allocation moved, in bytes
+const uint64_t MAX_STACK_FRAME = 4096; // static stack frame size limit
+
+/*
+ * Whether the address returned by an allocation reaches a phi or select.
+ * If it does not, every use of one dynamic allocation happens before the
+ * allocating call executes again (the value would otherwise have to be
+ * carried across iterations by a phi, or stored, which counts as capturing
+ * it), so a single stack slot can serve all of them even inside a loop.
+ */
+bool reachesPhi(Value *value) {
+  std::vector<Value *> worklist = {value};
+  while (!worklist.empty()) {
+    Value *v = worklist.back();
+    worklist.pop_back();
+    for (User *user : v->users()) {
+      if (isa<PHINode>(user) || isa<SelectInst>(user))
+        return true;
+      if (isa<BitCastInst>(user) || isa<GetElementPtrInst>(user) ||
+          isa<AddrSpaceCastInst>(user))
+        worklist.push_back(user);
+    }
+  }
+  return false;
+}
+
+struct StackAlloc : public FunctionPass {
+  static char ID;
+  bool report;
+  unsigned converted;
+
+  explicit StackAlloc(bool report = false)
+      : FunctionPass(ID), report(report), converted(0) {}
+
+  bool runOnFunction(Function &func) override {
+    Module *module = func.getParent();
+    std::vector<std::pair<CallInst *, bool>> candidates;
+    for (bool atomic : {false, true}) {
+      Function *alloc =
+          module->getFunction(atomic ? "seq_alloc_atomic" : "seq_alloc");
+      if (!alloc)
+        continue;
+      for (User *user : alloc->users()) {
+        auto *call = dyn_cast<CallInst>(user);
+        if (call && call->getFunction() == &func &&
+            call->getCalledFunction() == alloc)
+          candidates.emplace_back(call, atomic);
+      }
+    }
+
+    if (candidates.empty())
+      return false;
+
+    LLVMContext &context = func.getContext();
+    const DataLayout &layout = module->getDataLayout();
+    uint64_t frame = 0;
+    for (Instruction &inst : func.getEntryBlock()) {
+      auto *alloca = dyn_cast<AllocaInst>(&inst);
+      if (alloca && alloca->isStaticAlloca())
+        frame += layout.getTypeAllocSize(alloca->getAllocatedType()) *
+                 cast<ConstantInt>(alloca->getArraySize())->getZExtValue();
+    }
+    bool changed = false;
+
+    for (auto &candidate : candidates) {
+      CallInst *call = candidate.first;
+      auto *sizeVal = dyn_cast<ConstantInt>(call->getArgOperand(0));
+      if (!sizeVal)
+        continue;
+
+      const uint64_t size = sizeVal->getZExtValue();
+      if (size == 0 || size > MAX_STACK_ALLOC ||
+          frame + size > MAX_STACK_FRAME)
+        continue;
+
+      if (PointerMayBeCaptured(call, /*ReturnCaptures=*/true,
+                               /*StoreCaptures=*/true) ||
+          reachesPhi(call))
+        continue;
+
+      IRBuilder<> entry(&*func.getEntryBlock().getFirstInsertionPt());
+      AllocaInst *slot = entry.CreateAlloca(
+          ArrayType::get(IntegerType::getInt8Ty(context), size));
+      slot->setAlignment(16);
+
+      IRBuilder<> builder(call);
+      Value *mem = builder.CreateBitCast(slot, call->getType());
+      // GC_MALLOC returns zeroed memory, which constructors may rely on
+      if (!candidate.second)
+        builder.CreateMemSet(mem, builder.getInt8(0), size, 16);
+
+      call->replaceAllUsesWith(mem);
+      call->eraseFromParent();
+
+      if (report)
+        errs() << "stack-alloc: " << size << " byte "
+               << (candidate.second ? "atomic " : "") << "allocation in "
+               << func.getName() << "\n";
+
+      frame += size;
+      ++converted;
+      changed = true;
+    }
+
+    return changed;
+  }
+
+  bool doFinalization(Module &module) override {
+    if (report)
+      errs() << "stack-alloc: " << converted
+             << " allocation site(s) moved to the stack\n";
+    return false;
+  }
+};
+} // namespace
+
+char StackAlloc::ID = 0;
+
+FunctionPass *seq::createStackAllocPass(bool report) {
+  return new StackAlloc(report);
+}
+
+namespace {
+const char *const MULTIVERSIONED_ATTR = "seq-multiversioned";
+// seq_cpu_has_avx2 in the runtime checks for each of these
+const char *const AVX2_FEATURES = "+avx,+avx2,+bmi,+bmi2,+fma,+popcnt,+sse3,"
+                                  "+sse4.1,+sse4.2,+ssse3";
+const unsigned MAX_MULTIVERSION_SIZE = 2000; // instructions per function
+
+// innermost loop that only loads, stores and computes, i.e. that the loop
+// vectorizer has a chance of handling
+bool isVectorizationCandidate(Loop *loop) {
+  if (!loop->empty())
+    return false;
+  bool accessesMemory = false;
+  for (BasicBlock *block : loop->blocks()) {
+    for (Instruction &inst : *block) {
+      if (isa<InvokeInst>(inst) ||
+          (isa<CallInst>(inst) && !isa<IntrinsicInst>(inst)))
+        return false;
+      if (isa<LoadInst>(inst) || isa<StoreInst>(inst))
+        accessesMemory = true;
+    }
+  }
+  return accessesMemory;
+}
+
+bool hasVectorizationCandidate(Function &func) {
+  DominatorTree dt(func);
+  LoopInfo loops(dt);
+  for (Loop *loop : loops.getLoopsInPreorder()) {
+    if (isVectorizationCandidate(loop))
+      return true;
+  }
+  return false;
+}
+
+// whether 'func' calls a dispatcher or clone, e.g. after one was inlined
+// into it; cloning it again would only duplicate the versions it calls
+bool callsMultiversioned(Function &func) {
+  for (BasicBlock &block : func) {
+    for (Instruction &inst : block) {
+      CallSite call(&inst);
+      Function *callee = call ? call.getCalledFunction() : nullptr;
+      if (callee && callee->hasFnAttribute(MULTIVERSIONED_ATTR))
+        return true;
+    }
+  }
+  return false;
+}
+
+unsigned instructionCount(Function &func) {
+  unsigned count = 0;
+  for (BasicBlock &block : func)
+    count += block.size();
+  return count;
+}
+
+Function *makeClone(Function &func, const std::string &suffix) {
+  ValueToValueMapTy vmap;
+  Function *clone = CloneFunction(&func, vmap);
+  clone->setName(func.getName() + suffix);
+  clone->setLinkage(GlobalValue::PrivateLinkage);
+  clone->addFnAttr(MULTIVERSIONED_ATTR);
+  return clone;
+}
+
+struct Multiversion : public ModulePass {
+  static char ID;
+
+  Multiversion() : ModulePass(ID) {}
+
+  bool runOnModule(Module &module) override {
+    if (Triple(module.getTargetTriple()).getArch() != Triple::x86_64)
+      return false;
+
+    std::vector<Function *> candidates;
+    for (Function &func : module) {
+      if (func.isDeclaration() || func.isVarArg() ||
+          func.hasFnAttribute(MULTIVERSIONED_ATTR) ||
+          func.hasFnAttribute("coroutine.presplit") ||
+          instructionCount(func) > MAX_MULTIVERSION_SIZE ||
+          callsMultiversioned(func))
+        continue;
+      if (hasVectorizationCandidate(func))
+        candidates.push_back(&func);
+    }
+
+    if (candidates.empty())
+      return false;
+
+    LLVMContext &context = module.getContext();
+    auto *hasAVX2 = cast<Function>(module.getOrInsertFunction(
+        "seq_cpu_has_avx2", IntegerType::getInt1Ty(context)));
+    hasAVX2->setDoesNotThrow();
+    hasAVX2->setDoesNotAccessMemory();
+
+    for (Function *func : candidates) {
+      Function *base = makeClone(*func, ".base");
+      Function *avx2 = makeClone(*func, ".avx2");
+      std::string features =
+          avx2->getFnAttribute("target-features").getValueAsString();
+      avx2->addFnAttr("target-features", features.empty()
+                                             ? AVX2_FEATURES
+                                             : features + "," + AVX2_FEATURES);
+
+      // the original becomes the dispatcher, so existing callers and
+      // function pointers pick up the right version
+      GlobalValue::LinkageTypes linkage = func->getLinkage();
+      func->deleteBody();
+      func->setLinkage(linkage);
+      func->addFnAttr(MULTIVERSIONED_ATTR);
+
+      std::vector<Value *> args;
+      for (Argument &arg : func->args())
+        args.push_back(&arg);
+
+      BasicBlock *entry = BasicBlock::Create(context, "entry", func);
+      BasicBlock *fast = BasicBlock::Create(context, "avx2", func);
+      BasicBlock *slow = BasicBlock::Create(context, "base", func);
+      IRBuilder<> builder(entry);
+      builder.CreateCondBr(builder.CreateCall(hasAVX2), fast, slow);
+
+      for (auto &version : {std::make_pair(fast, avx2),
+                            std::make_pair(slow, base)}) {
+        builder.SetInsertPoint(version.first);
+        CallInst *call = builder.CreateCall(version.second, args);
+        // keep byval, sret etc., which the callee's signature relies on
+        call->setAttributes(version.second->getAttributes().removeAttributes(
+            context, AttributeList::FunctionIndex));
+        call->setCallingConv(version.second->getCallingConv());
+        call->setTailCall();
+        if (func->getReturnType()->isVoidTy())
+          builder.CreateRetVoid();
+        else
+          builder.CreateRet(call);
+      }
+    }
+
+    return true;
+  }
+};
+} // namespace
+
+char Multiversion::ID = 0;
+
+ModulePass *seq::createMultiversionPass() { return new Multiversion(); }
+
+namespace {
+struct CoroAllocCount : public FunctionPass {
+  static char ID;
+  unsigned *count;
+
+  explicit CoroAllocCount(unsigned *count = nullptr)
+      : FunctionPass(ID), count(count) {}
+
+  void getAnalysisUsage(AnalysisUsage &usage) const override {
+    usage.setPreservesAll();
+  }
+
+  bool runOnFunction(Function &func) override {
+    for (BasicBlock &block : func) {
+      for (Instruction &inst : block) {
+        if (auto *intrinsic = dyn_cast<IntrinsicInst>(&inst)) {
+          if (intrinsic->getIntrinsicID() == Intrinsic::coro_alloc)
+            ++*count;
+        }
+      }
+    }
+    return false;
+  }
+};
+} // namespace
+
+char CoroAllocCount::ID = 0;
+
+FunctionPass *seq::createCoroAllocCountPass(unsigned *count) {
+  return new CoroAllocCount(count);
+}
@@ -21,6 +21,8 @@ template <typename Type_> static uintptr_t ReadType(const uint8_t *&p) {
 }
 } // namespace
 
+void seq_arena_pin();
+
 static int64_t ourBaseFromUnwindOffset;
 
 static const unsigned char ourBaseExcpClassChars[] = {'o', 'b', 'j', '\0',
@@ -70,6 +72,7 @@ static void seq_delete_unwind_exc(_Unwind_Reason_Code reason,
 }
 
 SEQ_FUNC void *seq_alloc_exc(int type, void *obj) {
+  seq_arena_pin();
   const size_t size = sizeof(OurException);
   auto *e = (OurException *)memset(seq_alloc(size), 0, size);
   assert(e);
@@ -84,6 +87,7 @@ SEQ_FUNC void seq_terminate(void *exc) {
   auto *base = (OurBaseException_t *)((char *)exc + seq_exc_offset());
   void *obj = base->obj;
   auto *msg = (seq_str_t *)obj;
+  seq_flush(); // other threads may still be printing
   fputs("terminating with exception: ", stderr);
   fwrite(msg->str, 1, (size_t)msg->len, stderr);
   fputs("\n", stderr);
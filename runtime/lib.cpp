@@ -1,6 +1,10 @@
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
+#include <cctype>
 #include <cerrno>
+#include <chrono>
 #include <climits>
 #include <cstdio>
 #include <cstdlib>
@@ -8,6 +12,8 @@
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <mutex>
+#include <new>
 #include <string>
 #include <unwind.h>
 #include <vector>
@@ -20,8 +26,12 @@
 #include "ksw2/ksw2.h"
 #include "lib.h"
 #include <gc.h>
+#include <fcntl.h>
 #include <htslib/sam.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <unistd.h>
 
 using namespace std;
 
@@ -31,10 +41,17 @@ using namespace std;
 
 void seq_exc_init();
 void seq_py_init();
+static void seq_gc_preinit();
+static void seq_gc_init();
+static void seq_arena_init();
+static void seq_coro_pool_init();
+static void seq_stdout_init();
 
 SEQ_FUNC void seq_init() {
+  seq_gc_preinit();
   GC_INIT();
   GC_set_warn_proc(GC_ignore_warn_proc);
+  seq_gc_init();
 
 #if THREADED
   GC_allow_register_threads();
@@ -47,6 +64,9 @@ SEQ_FUNC void seq_init() {
   }
 #endif
 
+  seq_arena_init();
+  seq_coro_pool_init();
+  seq_stdout_init();
   seq_exc_init();
   seq_py_init();
 }
@@ -56,17 +76,339 @@ SEQ_FUNC void seq_assert_failed(seq_str_t file, seq_int_t line) {
   exit(EXIT_FAILURE);
 }
 
+// used by multiversioned functions to pick their AVX2 clone; must check
+// every feature that the clones are compiled for (AVX2_FEATURES in passes.cpp)
+SEQ_FUNC bool seq_cpu_has_avx2() {
+#if defined(__x86_64__)
+  static const bool hasAVX2 =
+      __builtin_cpu_supports("avx") && __builtin_cpu_supports("avx2") &&
+      __builtin_cpu_supports("bmi") && __builtin_cpu_supports("bmi2") &&
+      __builtin_cpu_supports("fma") && __builtin_cpu_supports("popcnt") &&
+      __builtin_cpu_supports("sse3") && __builtin_cpu_supports("sse4.1") &&
+      __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("ssse3");
+  return hasAVX2;
+#else
+  return false;
+#endif
+}
+
+/*
+ * Arena allocation
+ *
+ * Within an arena scope (gc.arena() in Seq), seq_alloc and seq_alloc_atomic
+ * bump-allocate from chunks owned by the calling thread's innermost arena,
+ * and everything is released at once when the scope ends, so per-record
+ * temporaries cost the GC neither allocations nor marking. Chunks are plain
+ * GC objects reachable from their (uncollectable) arena, so arena and GC
+ * objects may freely point to each other while the scope is live, but
+ * nothing allocated in a scope may be used after it ends. If an exception is
+ * raised inside a scope, its chunks are left to the GC rather than reused,
+ * since the exception object may live in one of them.
+ *
+ * Set SEQ_ARENA_DEBUG=1 to check for allocations escaping their scope.
+ * Released chunks are then filled with 0xdb bytes instead of being reused,
+ * so that stale references read obviously bad values. They are also tracked
+ * with disappearing links, which the GC clears once a chunk is unreachable;
+ * every ARENA_DEBUG_CHECK released chunks, a full collection is run and any
+ * chunk that is still referenced is reported. Objects from outside the
+ * current scope that get new storage inside it are reported as well, since
+ * that storage dies with the scope: arena allocations of an outer scope that
+ * are resized (e.g. a list appended to), and dicts and sets that allocate
+ * new tables (seq_arena_check_grow). GC objects resized inside a scope are
+ * fine, as GC_REALLOC keeps them in the GC heap.
+ */
+
+static const size_t ARENA_CHUNK_SIZE = 1 << 20;
+static const size_t ARENA_MAX_CACHED = 8; // free chunks kept per thread
+static const uint64_t ARENA_MAGIC = 0x414e455241514553; // "SEQARENA"
+static const size_t ARENA_DEBUG_CHECK = 64; // released chunks per check
+static const size_t ARENA_DEBUG_MAX = 1024; // released chunks tracked
+
+namespace {
+struct ArenaChunk {
+  uint64_t magic;
+  ArenaChunk *next;
+  size_t size; // usable bytes following this header
+  size_t used;
+
+  char *data() { return (char *)(this + 1); }
+};
+
+struct Arena {
+  Arena *parent;
+  ArenaChunk *chunks;
+  bool pinned;
+};
+
+// per-thread cache of released chunks and arenas; allocated uncollectable
+// so that the GC does not reclaim the cached chunks
+struct ArenaCache {
+  ArenaChunk *freeChunks;
+  size_t numFreeChunks;
+  Arena *freeArenas;
+  // SEQ_ARENA_DEBUG only: disappearing links to chunks of ended scopes
+  GC_hidden_pointer *released;
+  size_t numReleased;
+};
+
+bool arenaDebug = false;
+std::atomic<bool> arenasUsed(false);
+
+struct ArenaCacheHandle {
+  ArenaCache *cache = nullptr;
+  ~ArenaCacheHandle() {
+    if (!cache)
+      return;
+    for (ArenaChunk *chunk = cache->freeChunks; chunk;) {
+      ArenaChunk *next = chunk->next;
+      GC_FREE(chunk);
+      chunk = next;
+    }
+    for (Arena *arena = cache->freeArenas; arena;) {
+      Arena *next = arena->parent;
+      GC_FREE(arena);
+      arena = next;
+    }
+    if (cache->released) {
+      for (size_t i = 0; i < cache->numReleased; i++)
+        GC_unregister_disappearing_link((void **)&cache->released[i]);
+      GC_FREE(cache->released);
+    }
+    GC_FREE(cache);
+  }
+};
+
+thread_local ArenaCacheHandle arenaCacheHandle;
+
+ArenaCache *getArenaCache() {
+  ArenaCache *cache = arenaCacheHandle.cache;
+  if (!cache) {
+    cache = (ArenaCache *)GC_MALLOC_UNCOLLECTABLE(sizeof(ArenaCache));
+    arenaCacheHandle.cache = cache;
+  }
+  return cache;
+}
+
+// returns a zeroed chunk with at least 'size' usable bytes
+ArenaChunk *newArenaChunk(size_t size) {
+  ArenaCache *cache = getArenaCache();
+  ArenaChunk *chunk = cache->freeChunks;
+  if (size <= ARENA_CHUNK_SIZE && chunk) {
+    cache->freeChunks = chunk->next;
+    --cache->numFreeChunks;
+  } else {
+    size = std::max(size, ARENA_CHUNK_SIZE);
+    chunk = (ArenaChunk *)GC_MALLOC(sizeof(ArenaChunk) + size);
+    chunk->magic = ARENA_MAGIC;
+    chunk->size = size;
+  }
+  chunk->next = nullptr;
+  chunk->used = 0;
+  return chunk;
+}
+
+// the arena chunk containing 'p', or null if 'p' is not an arena allocation
+ArenaChunk *arenaChunkOf(void *p) {
+  if (!p || !arenasUsed.load(std::memory_order_relaxed))
+    return nullptr;
+  auto *base = (ArenaChunk *)GC_base(p);
+  return (base && base->magic == ARENA_MAGIC) ? base : nullptr;
+}
+
+bool arenaOwns(Arena *arena, ArenaChunk *chunk) {
+  for (ArenaChunk *c = arena->chunks; c; c = c->next) {
+    if (c == chunk)
+      return true;
+  }
+  return false;
+}
+
+// the following are only used with SEQ_ARENA_DEBUG
+
+void trackReleasedChunk(ArenaCache *cache, ArenaChunk *chunk) {
+  if (!cache->released)
+    cache->released = (GC_hidden_pointer *)GC_MALLOC_UNCOLLECTABLE(
+        ARENA_DEBUG_MAX * sizeof(GC_hidden_pointer));
+  if (cache->numReleased == ARENA_DEBUG_MAX)
+    return;
+  GC_hidden_pointer *link = &cache->released[cache->numReleased++];
+  *link = GC_HIDE_POINTER(chunk);
+  GC_general_register_disappearing_link((void **)link, chunk);
+}
+
+// run from seq_arena_push rather than pop, so that the stack is less likely
+// to still hold pointers to the chunks just released
+void checkReleasedChunks(ArenaCache *cache) {
+  GC_gcollect();
+  size_t escaped = 0;
+  for (size_t i = 0; i < cache->numReleased; i++) {
+    if (cache->released[i]) {
+      GC_unregister_disappearing_link((void **)&cache->released[i]);
+      ++escaped;
+    }
+  }
+  cache->numReleased = 0;
+  if (escaped)
+    fprintf(stderr,
+            "arena: %zu chunk(s) of ended arena scopes are still referenced; "
+            "an arena allocation may have escaped its scope\n",
+            escaped);
+}
+} // namespace
+
+// innermost arena of the calling thread, or null; not static so that the
+// seq_alloc fast path can be inlined into native executables
+thread_local void *seqCurrentArena = nullptr;
+
+// kept out of line for the same reason, as it depends on static state
+SEQ_FUNC __attribute__((noinline)) void *seq_arena_alloc(void *arenaPtr,
+                                                         size_t n) {
+  auto *arena = (Arena *)arenaPtr;
+  n = n ? (n + 15) & ~(size_t)15 : 16;
+  ArenaChunk *chunk = arena->chunks;
+  if (chunk && chunk->size - chunk->used >= n) {
+    void *p = chunk->data() + chunk->used;
+    chunk->used += n;
+    return p;
+  }
+
+  if (chunk && n > ARENA_CHUNK_SIZE / 4) {
+    // large allocations get a chunk of their own behind the current one, so
+    // that the latter's remaining space is not wasted
+    ArenaChunk *big = newArenaChunk(n);
+    big->used = n;
+    big->next = chunk->next;
+    chunk->next = big;
+    return big->data();
+  }
+
+  chunk = newArenaChunk(n);
+  chunk->used = n;
+  chunk->next = arena->chunks;
+  arena->chunks = chunk;
+  return chunk->data();
+}
+
+static void seq_arena_init() {
+  const char *env = getenv("SEQ_ARENA_DEBUG");
+  arenaDebug = env && strcmp(env, "0") != 0;
+}
+
+SEQ_FUNC void seq_arena_push() {
+  ArenaCache *cache = getArenaCache();
+  if (arenaDebug && cache->numReleased >= ARENA_DEBUG_CHECK)
+    checkReleasedChunks(cache);
+  Arena *arena = cache->freeArenas;
+  if (arena)
+    cache->freeArenas = arena->parent;
+  else
+    arena = (Arena *)GC_MALLOC_UNCOLLECTABLE(sizeof(Arena));
+  arena->parent = (Arena *)seqCurrentArena;
+  arena->chunks = nullptr;
+  arena->pinned = false;
+  seqCurrentArena = arena;
+  arenasUsed.store(true, std::memory_order_relaxed);
+}
+
+SEQ_FUNC void seq_arena_pop() {
+  auto *arena = (Arena *)seqCurrentArena;
+  if (!arena)
+    return;
+
+  ArenaCache *cache = getArenaCache();
+  ArenaChunk *chunks = arena->chunks;
+  arena->chunks = nullptr;
+  for (ArenaChunk *chunk = chunks; chunk;) {
+    ArenaChunk *next = chunk->next;
+    if (arena->pinned) {
+      // dropped; the GC reclaims it once nothing points into it
+    } else if (arenaDebug) {
+      memset(chunk->data(), 0xdb, chunk->used);
+      chunk->next = nullptr;
+      trackReleasedChunk(cache, chunk);
+    } else if (chunk->size == ARENA_CHUNK_SIZE &&
+               cache->numFreeChunks < ARENA_MAX_CACHED) {
+      memset(chunk->data(), 0, chunk->used);
+      chunk->next = cache->freeChunks;
+      cache->freeChunks = chunk;
+      ++cache->numFreeChunks;
+    } else {
+      GC_FREE(chunk);
+    }
+    chunk = next;
+  }
+
+  seqCurrentArena = arena->parent;
+  arena->parent = cache->freeArenas;
+  cache->freeArenas = arena;
+}
+
+// called when an exception is raised, which may be allocated in (and then
+// propagate out of) any of the active arenas
+void seq_arena_pin() {
+  for (auto *arena = (Arena *)seqCurrentArena; arena; arena = arena->parent)
+    arena->pinned = true;
+}
+
 /*
  * GC
  */
 
-SEQ_FUNC void *seq_alloc(size_t n) { return GC_MALLOC(n); }
+SEQ_FUNC void *seq_alloc(size_t n) {
+  void *arena = seqCurrentArena;
+  return arena ? seq_arena_alloc(arena, n) : GC_MALLOC(n);
+}
+
+SEQ_FUNC void *seq_alloc_atomic(size_t n) {
+  void *arena = seqCurrentArena;
+  return arena ? seq_arena_alloc(arena, n) : GC_MALLOC_ATOMIC(n);
+}
+
+static std::atomic<bool> arenaGrowReported(false);
+
+// SEQ_ARENA_DEBUG: object 'p' gets new storage from the current arena, which
+// is only safe if 'p' was allocated in that arena too
+static void reportArenaGrow(void *p) {
+  if (arenaGrowReported.exchange(true))
+    return;
+  fprintf(stderr,
+          "arena: object %p from outside the current arena scope grew inside "
+          "it; its new storage is released when the scope ends\n",
+          p);
+}
 
-SEQ_FUNC void *seq_alloc_atomic(size_t n) { return GC_MALLOC_ATOMIC(n); }
+// called by dict and set before they allocate new tables for object 'p'
+SEQ_FUNC void seq_arena_check_grow(void *p) {
+  auto *arena = (Arena *)seqCurrentArena;
+  if (!arenaDebug || !arena)
+    return;
+  ArenaChunk *chunk = arenaChunkOf(p);
+  if (!chunk || !arenaOwns(arena, chunk))
+    reportArenaGrow(p);
+}
 
-SEQ_FUNC void *seq_realloc(void *p, size_t n) { return GC_REALLOC(p, n); }
+SEQ_FUNC void *seq_realloc(void *p, size_t n) {
+  if (!p)
+    return seq_alloc(n);
+  ArenaChunk *chunk = arenaChunkOf(p);
+  // GC objects are resized by GC_REALLOC and stay GC objects, but arena
+  // allocations are copied into the current arena
+  if (arenaDebug && chunk && seqCurrentArena &&
+      !arenaOwns((Arena *)seqCurrentArena, chunk))
+    reportArenaGrow(p);
+  if (!chunk)
+    return GC_REALLOC(p, n);
+
+  // arena allocations do not record their size, so copy as much as fits
+  void *q = seq_alloc(n);
+  memcpy(q, p, std::min(n, (size_t)(chunk->data() + chunk->size - (char *)p)));
+  return q;
+}
 
-SEQ_FUNC void seq_free(void *p) { GC_FREE(p); }
+SEQ_FUNC void seq_free(void *p) {
+  if (!arenaChunkOf(p))
+    GC_FREE(p);
+}
 
 SEQ_FUNC void seq_register_finalizer(void *p,
                                      void (*f)(void *obj, void *data)) {
@@ -87,6 +429,248 @@ SEQ_FUNC void seq_gc_exclude_static_roots(void *start, void *end) {
   GC_exclude_static_roots(start, end);
 }
 
+/*
+ * GC configuration and statistics
+ *
+ * The collector is configured from the environment at startup:
+ *
+ *   SEQ_GC_MARKERS             number of parallel marker threads
+ *   SEQ_GC_INCREMENTAL=1       incremental (generational) collection
+ *   SEQ_GC_INITIAL_HEAP        initial heap size
+ *   SEQ_GC_MAX_HEAP            maximum heap size
+ *   SEQ_GC_FREE_SPACE_DIVISOR  trades collection frequency for heap growth
+ *                              (Boehm's default is 3; higher collects more)
+ *
+ * Sizes are in bytes with an optional K, M or G suffix. Collection counts
+ * and pause times are recorded through the collector's event callback.
+ */
+
+namespace {
+std::atomic<seq_int_t> gcPauseTotal(0), gcPauseMax(0);
+std::chrono::steady_clock::time_point gcPauseStart;
+
+void gcCollectionEvent(GC_EventType event) {
+  // called by the collecting thread with the allocator lock held
+  if (event == GC_EVENT_START) {
+    gcPauseStart = std::chrono::steady_clock::now();
+  } else if (event == GC_EVENT_END) {
+    seq_int_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - gcPauseStart)
+                       .count();
+    gcPauseTotal.store(gcPauseTotal.load(std::memory_order_relaxed) + ns,
+                       std::memory_order_relaxed);
+    if (ns > gcPauseMax.load(std::memory_order_relaxed))
+      gcPauseMax.store(ns, std::memory_order_relaxed);
+  }
+}
+
+// parses a byte count with an optional K/M/G suffix; 0 if absent, invalid
+// or too large to represent
+size_t gcSizeEnv(const char *name) {
+  const char *env = getenv(name);
+  if (!env || !isdigit((unsigned char)*env)) // strtoull accepts "-1"
+    return 0;
+  char *end;
+  errno = 0;
+  unsigned long long n = strtoull(env, &end, 10);
+  if (errno == ERANGE)
+    return 0;
+  const char *suffixes = "KMG";
+  if (*end) {
+    const char *suffix = strchr(suffixes, toupper(*end));
+    if (!suffix)
+      return 0;
+    const int shift = 10 * (suffix - suffixes + 1);
+    if (n > (ULLONG_MAX >> shift))
+      return 0;
+    n <<= shift;
+    ++end;
+  }
+  return (*end || n > SIZE_MAX) ? 0 : (size_t)n;
+}
+} // namespace
+
+static void seq_gc_preinit() {
+  // only read by the collector itself, during initialization
+  const char *markers = getenv("SEQ_GC_MARKERS");
+  if (markers)
+    setenv("GC_MARKERS", markers, 1);
+}
+
+static void seq_gc_init() {
+  GC_set_on_collection_event(gcCollectionEvent);
+
+  if (size_t n = gcSizeEnv("SEQ_GC_MAX_HEAP"))
+    GC_set_max_heap_size(n);
+
+  if (size_t n = gcSizeEnv("SEQ_GC_INITIAL_HEAP")) {
+    size_t heap = GC_get_heap_size();
+    if (n > heap)
+      GC_expand_hp(n - heap);
+  }
+
+  if (const char *env = getenv("SEQ_GC_FREE_SPACE_DIVISOR")) {
+    long divisor = strtol(env, nullptr, 10);
+    if (divisor > 0)
+      GC_set_free_space_divisor((GC_word)divisor);
+  }
+
+  const char *incremental = getenv("SEQ_GC_INCREMENTAL");
+  if (incremental && strcmp(incremental, "0") != 0)
+    GC_enable_incremental();
+}
+
+SEQ_FUNC void seq_gc_collect() { GC_gcollect(); }
+
+SEQ_FUNC void seq_gc_enable_incremental() { GC_enable_incremental(); }
+
+SEQ_FUNC void seq_gc_set_free_space_divisor(seq_int_t divisor) {
+  if (divisor > 0)
+    GC_set_free_space_divisor((GC_word)divisor);
+}
+
+SEQ_FUNC void seq_gc_set_max_heap_size(seq_int_t size) {
+  GC_set_max_heap_size(size > 0 ? (GC_word)size : ~(GC_word)0);
+}
+
+SEQ_FUNC bool seq_gc_expand_heap(seq_int_t size) {
+  return size > 0 && GC_expand_hp((size_t)size);
+}
+
+// collections, total and longest pause (ns), heap size, free bytes in the
+// heap, bytes allocated since startup, and number of marker threads
+SEQ_FUNC void seq_gc_stats(seq_int_t *stats) {
+  stats[0] = (seq_int_t)GC_get_gc_no();
+  stats[1] = gcPauseTotal.load(std::memory_order_relaxed);
+  stats[2] = gcPauseMax.load(std::memory_order_relaxed);
+  stats[3] = (seq_int_t)GC_get_heap_size();
+  stats[4] = (seq_int_t)GC_get_free_bytes();
+  stats[5] = (seq_int_t)GC_get_total_bytes();
+  stats[6] = GC_get_parallel() + 1;
+}
+
+/*
+ * Coroutine frame pool
+ *
+ * Generator and prefetch task frames are recycled through per-thread free
+ * lists segregated by size class, instead of costing a GC allocation each.
+ * Frames carry a 16-byte header holding their size class (-1 if too large
+ * to be pooled) and, while on a free list, the next free frame. Each pool is
+ * allocated uncollectable so that the GC keeps its free frames alive; frames
+ * are cleared when freed so they do not retain stale pointers. Set
+ * SEQ_CORO_POOL=0 to allocate every frame from the GC instead.
+ */
+
+static const size_t CORO_HEADER_SIZE = 16;
+static const size_t CORO_CLASS_SIZE = 64;
+static const size_t CORO_NUM_CLASSES = 64;  // frames up to 4 KB are pooled
+static const uint32_t CORO_MAX_FREE = 256;  // free frames kept per class
+
+namespace {
+struct CoroPool {
+  void *free[CORO_NUM_CLASSES];
+  uint32_t numFree[CORO_NUM_CLASSES];
+  // only written by the owning thread
+  std::atomic<seq_int_t> allocs, reuses, frees;
+};
+
+void bump(std::atomic<seq_int_t> &counter) {
+  counter.store(counter.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+}
+
+bool coroPoolEnabled = true;
+std::mutex coroPoolsLock;
+std::vector<CoroPool *> coroPools;
+seq_int_t coroRetiredStats[3] = {0, 0, 0};
+
+void retireCoroPool(CoroPool *pool) {
+  std::lock_guard<std::mutex> guard(coroPoolsLock);
+  coroRetiredStats[0] += pool->allocs;
+  coroRetiredStats[1] += pool->reuses;
+  coroRetiredStats[2] += pool->frees;
+  coroPools.erase(std::find(coroPools.begin(), coroPools.end(), pool));
+  pool->~CoroPool();
+  GC_FREE(pool);
+}
+
+struct CoroPoolHandle {
+  CoroPool *pool = nullptr;
+  ~CoroPoolHandle() {
+    if (pool)
+      retireCoroPool(pool);
+  }
+};
+
+thread_local CoroPoolHandle coroPoolHandle;
+
+CoroPool *getCoroPool() {
+  CoroPool *pool = coroPoolHandle.pool;
+  if (!pool) {
+    pool = new (GC_MALLOC_UNCOLLECTABLE(sizeof(CoroPool))) CoroPool();
+    std::lock_guard<std::mutex> guard(coroPoolsLock);
+    coroPools.push_back(pool);
+    coroPoolHandle.pool = pool;
+  }
+  return pool;
+}
+} // namespace
+
+static void seq_coro_pool_init() {
+  const char *env = getenv("SEQ_CORO_POOL");
+  coroPoolEnabled = !(env && strcmp(env, "0") == 0);
+}
+
+SEQ_FUNC void *seq_coro_alloc(size_t n) {
+  CoroPool *pool = getCoroPool();
+  size_t cls = (n + CORO_HEADER_SIZE - 1) / CORO_CLASS_SIZE;
+  if (!coroPoolEnabled || cls >= CORO_NUM_CLASSES) {
+    auto *mem = (char *)GC_MALLOC(n + CORO_HEADER_SIZE);
+    ((seq_int_t *)mem)[0] = -1;
+    bump(pool->allocs);
+    return mem + CORO_HEADER_SIZE;
+  }
+
+  auto *mem = (char *)pool->free[cls];
+  if (mem) {
+    pool->free[cls] = ((void **)mem)[1];
+    ((void **)mem)[1] = nullptr;
+    --pool->numFree[cls];
+    bump(pool->reuses);
+  } else {
+    mem = (char *)GC_MALLOC((cls + 1) * CORO_CLASS_SIZE);
+    ((seq_int_t *)mem)[0] = (seq_int_t)cls;
+    bump(pool->allocs);
+  }
+  return mem + CORO_HEADER_SIZE;
+}
+
+SEQ_FUNC void seq_coro_free(void *frame) {
+  char *mem = (char *)frame - CORO_HEADER_SIZE;
+  seq_int_t cls = ((seq_int_t *)mem)[0];
+  CoroPool *pool = getCoroPool();
+  bump(pool->frees);
+  if (cls < 0 || pool->numFree[cls] >= CORO_MAX_FREE)
+    return;
+  memset(frame, 0, (cls + 1) * CORO_CLASS_SIZE - CORO_HEADER_SIZE);
+  ((void **)mem)[1] = pool->free[cls];
+  pool->free[cls] = mem;
+  ++pool->numFree[cls];
+}
+
+// fresh frame allocations, reused frames and freed frames, over all threads
+SEQ_FUNC void seq_coro_pool_stats(seq_int_t *stats) {
+  std::lock_guard<std::mutex> guard(coroPoolsLock);
+  stats[0] = coroRetiredStats[0];
+  stats[1] = coroRetiredStats[1];
+  stats[2] = coroRetiredStats[2];
+  for (CoroPool *pool : coroPools) {
+    stats[0] += pool->allocs.load(std::memory_order_relaxed);
+    stats[1] += pool->reuses.load(std::memory_order_relaxed);
+    stats[2] += pool->frees.load(std::memory_order_relaxed);
+  }
+}
+
 /*
  * String conversion
  */
@@ -104,10 +688,14 @@ static seq_str_t string_conv(const char *fmt, const size_t size, T t) {
 }
 
 SEQ_FUNC seq_str_t seq_str_int(seq_int_t n) {
-  return string_conv("%ld", 22, n);
+  auto *p = (char *)seq_alloc_atomic(SEQ_FMT_BUF_SIZE);
+  return {seq_fmt_int(p, n), p};
 }
 
-SEQ_FUNC seq_str_t seq_str_float(double f) { return string_conv("%g", 16, f); }
+SEQ_FUNC seq_str_t seq_str_float(double f) {
+  auto *p = (char *)seq_alloc_atomic(SEQ_FMT_BUF_SIZE);
+  return {seq_fmt_float(p, f), p};
+}
 
 SEQ_FUNC seq_str_t seq_str_bool(bool b) {
   return string_conv("%s", 6, b ? "True" : "False");
@@ -157,8 +745,181 @@ SEQ_FUNC seq_str_t seq_check_errno() {
   return {0, nullptr};
 }
 
+/*
+ * Buffered standard output
+ *
+ * print appends to a per-thread buffer rather than calling fwrite for every
+ * fragment. A full buffer is written out up to its last newline, under a
+ * lock, so that lines printed by different threads never interleave; the
+ * unfinished line stays buffered. Buffers are flushed by seq_flush, at exit,
+ * before an uncaught exception terminates the program (only the buffer of the
+ * thread that raised it), and after every completed line when stdout is a
+ * terminal. SEQ_STDOUT_BUFFER sets the size of each buffer in bytes (default
+ * 64 KB); 0 writes every fragment directly.
+ *
+ * A buffer is only ever touched by its own thread, except by seq_flush_all
+ * once the program has finished and the other threads are idle. To keep
+ * output in program order, parallel pipeline stages write out the completed
+ * lines of the thread that starts them before they begin, and those of the
+ * worker at the end of each task (seq_flush_lines).
+ */
+
+namespace {
+struct OutBuf {
+  char *data;
+  size_t len;
+  size_t cap;
+};
+
+std::mutex outLock; // guards outBufs and writes to stdout
+std::vector<OutBuf *> outBufs;
+size_t outBufSize = 1 << 16;
+bool outLineMode = false;
+
+// writes buf[0:n] and then p[0:len] to stdout, keeping the rest of buf
+void writeOut(OutBuf *buf, size_t n, const char *p, size_t len) {
+  {
+    std::lock_guard<std::mutex> guard(outLock);
+    fwrite(buf->data, 1, n, stdout);
+    if (len)
+      fwrite(p, 1, len, stdout);
+    if (outLineMode)
+      fflush(stdout);
+  }
+  buf->len -= n;
+  memmove(buf->data, buf->data + n, buf->len);
+}
+
+// writes out everything up to the last newline, or everything if 'all'
+void flushOut(OutBuf *buf, bool all) {
+  size_t n = buf->len;
+  if (!all) {
+    while (n > 0 && buf->data[n - 1] != '\n')
+      --n;
+  }
+  if (n > 0)
+    writeOut(buf, n, nullptr, 0);
+}
+
+void retireOutBuf(OutBuf *buf) {
+  flushOut(buf, true);
+  {
+    std::lock_guard<std::mutex> guard(outLock);
+    outBufs.erase(std::find(outBufs.begin(), outBufs.end(), buf));
+  }
+  free(buf->data);
+  delete buf;
+}
+
+struct OutBufHandle {
+  OutBuf *buf = nullptr;
+  ~OutBufHandle() {
+    if (buf)
+      retireOutBuf(buf);
+  }
+};
+
+thread_local OutBufHandle outBufHandle;
+
+// null if output is unbuffered
+OutBuf *getOutBuf() {
+  OutBuf *buf = outBufHandle.buf;
+  if (!buf && outBufSize) {
+    buf = new OutBuf{(char *)malloc(outBufSize), 0, outBufSize};
+    std::lock_guard<std::mutex> guard(outLock);
+    outBufs.push_back(buf);
+    outBufHandle.buf = buf;
+  }
+  return buf;
+}
+
+// makes room for n more bytes, returning false if they can never fit
+bool reserveOut(OutBuf *buf, size_t n) {
+  if (buf->len + n <= buf->cap)
+    return true;
+  flushOut(buf, false);
+  if (buf->len + n <= buf->cap)
+    return true;
+  flushOut(buf, true);
+  return n <= buf->cap;
+}
+
+void printed(OutBuf *buf, const char *p, size_t n) {
+  if (outLineMode && memchr(p, '\n', n))
+    flushOut(buf, false);
+}
+
+// only safe while no other thread is printing
+void flushAllOut() {
+  std::lock_guard<std::mutex> guard(outLock);
+  for (OutBuf *buf : outBufs) {
+    fwrite(buf->data, 1, buf->len, stdout);
+    buf->len = 0;
+  }
+  fflush(stdout);
+}
+} // namespace
+
+static void seq_stdout_init() {
+  const char *env = getenv("SEQ_STDOUT_BUFFER");
+  if (env)
+    outBufSize = (size_t)strtoull(env, nullptr, 10);
+  outLineMode = isatty(fileno(stdout));
+  atexit(flushAllOut);
+}
+
+// writes out every thread's buffered output; the other threads must be idle
+SEQ_FUNC void seq_flush_all() { flushAllOut(); }
+
+// writes out the calling thread's completed lines
+SEQ_FUNC void seq_flush_lines() {
+  if (OutBuf *buf = outBufHandle.buf)
+    flushOut(buf, false);
+}
+
+SEQ_FUNC void seq_flush() {
+  if (OutBuf *buf = outBufHandle.buf)
+    flushOut(buf, true);
+  std::lock_guard<std::mutex> guard(outLock);
+  fflush(stdout);
+}
+
 SEQ_FUNC void seq_print(seq_str_t str) {
-  fwrite(str.str, 1, (size_t)str.len, stdout);
+  OutBuf *buf = getOutBuf();
+  auto n = (size_t)str.len;
+  if (!buf) {
+    fwrite(str.str, 1, n, stdout);
+    return;
+  }
+  if (!reserveOut(buf, n)) {
+    writeOut(buf, buf->len, str.str, n);
+    return;
+  }
+  memcpy(buf->data + buf->len, str.str, n);
+  buf->len += n;
+  printed(buf, str.str, n);
+}
+
+// print fast paths that format straight into the buffer
+
+SEQ_FUNC void seq_print_int(seq_int_t x) {
+  OutBuf *buf = getOutBuf();
+  if (!buf || !reserveOut(buf, SEQ_FMT_BUF_SIZE)) {
+    char tmp[SEQ_FMT_BUF_SIZE];
+    seq_print({seq_fmt_int(tmp, x), tmp});
+    return;
+  }
+  buf->len += seq_fmt_int(buf->data + buf->len, x);
+}
+
+SEQ_FUNC void seq_print_float(double x) {
+  OutBuf *buf = getOutBuf();
+  if (!buf || !reserveOut(buf, SEQ_FMT_BUF_SIZE)) {
+    char tmp[SEQ_FMT_BUF_SIZE];
+    seq_print({seq_fmt_float(tmp, x), tmp});
+    return;
+  }
+  buf->len += seq_fmt_float(buf->data + buf->len, x);
 }
 
 SEQ_FUNC void *seq_stdin() { return stdin; }
@@ -174,6 +935,64 @@ SEQ_FUNC int seq_time() {
   return time_ms;
 }
 
+/*
+ * Memory-mapped files
+ *
+ * Files are mapped read-only and shared, so that processes mapping the same
+ * file share one copy in the page cache. 'populate' pre-faults the whole file
+ * (where MAP_POPULATE exists) and 'hugepages' asks for transparent huge pages,
+ * which only take effect for files on tmpfs/hugetlbfs or on kernels that
+ * support them for read-only file mappings. On failure, returns null and
+ * leaves errno set.
+ */
+
+SEQ_FUNC void *seq_mmap_file(seq_str_t path, bool populate, bool hugepages,
+                             seq_int_t *size) {
+  string name(path.str, (size_t)path.len);
+  errno = 0;
+  int fd = open(name.c_str(), O_RDONLY);
+  if (fd < 0)
+    return nullptr;
+
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    int err = errno;
+    close(fd);
+    errno = err;
+    return nullptr;
+  }
+
+  int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+  if (populate)
+    flags |= MAP_POPULATE;
+#endif
+  void *mem = mmap(nullptr, (size_t)st.st_size, PROT_READ, flags, fd, 0);
+  int err = errno;
+  close(fd);
+  if (mem == MAP_FAILED) {
+    errno = err;
+    return nullptr;
+  }
+
+#ifdef MADV_HUGEPAGE
+  if (hugepages)
+    madvise(mem, (size_t)st.st_size, MADV_HUGEPAGE);
+#endif
+#ifndef MAP_POPULATE
+  if (populate)
+    madvise(mem, (size_t)st.st_size, MADV_WILLNEED);
+#endif
+
+  errno = 0;
+  *size = (seq_int_t)st.st_size;
+  return mem;
+}
+
+SEQ_FUNC void seq_munmap(void *mem, seq_int_t size) {
+  munmap(mem, (size_t)size);
+}
+
 /*
  * Alignment
  *
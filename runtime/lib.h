@@ -27,6 +27,7 @@ template <typename T = void> struct seq_arr_t {
 
 SEQ_FUNC void seq_init();
 SEQ_FUNC void seq_assert_failed(seq_str_t file, seq_int_t line);
+SEQ_FUNC bool seq_cpu_has_avx2();
 
 SEQ_FUNC void *seq_alloc(size_t n);
 SEQ_FUNC void *seq_alloc_atomic(size_t n);
@@ -34,6 +35,15 @@ SEQ_FUNC void *seq_realloc(void *p, size_t n);
 SEQ_FUNC void seq_free(void *p);
 SEQ_FUNC void seq_register_finalizer(void *p, void (*f)(void *obj, void *data));
 
+SEQ_FUNC void seq_arena_push();
+SEQ_FUNC void seq_arena_pop();
+SEQ_FUNC void *seq_arena_alloc(void *arena, size_t n);
+SEQ_FUNC void seq_arena_check_grow(void *p);
+
+SEQ_FUNC void *seq_coro_alloc(size_t n);
+SEQ_FUNC void seq_coro_free(void *frame);
+SEQ_FUNC void seq_coro_pool_stats(seq_int_t *stats);
+
 SEQ_FUNC void *seq_alloc_exc(int type, void *obj);
 SEQ_FUNC void seq_throw(void *exc);
 SEQ_FUNC _Unwind_Reason_Code seq_personality(int version,
@@ -51,6 +61,21 @@ SEQ_FUNC seq_str_t seq_str_byte(char c);
 SEQ_FUNC seq_str_t seq_str_ptr(void *p);
 SEQ_FUNC seq_str_t seq_str_tuple(seq_str_t *strs, seq_int_t n);
 
+// in-place number formatting into a buffer of at least SEQ_FMT_BUF_SIZE
+// bytes, returning the number of characters written (see fmt.cpp)
+#define SEQ_FMT_BUF_SIZE 32
+SEQ_FUNC seq_int_t seq_fmt_int(char *buf, seq_int_t n);
+SEQ_FUNC seq_int_t seq_fmt_float(char *buf, double f);
+
 SEQ_FUNC void seq_print(seq_str_t str);
+SEQ_FUNC void seq_print_int(seq_int_t x);
+SEQ_FUNC void seq_print_float(double x);
+SEQ_FUNC void seq_flush();
+SEQ_FUNC void seq_flush_all();
+SEQ_FUNC void seq_flush_lines();
+
+SEQ_FUNC void *seq_mmap_file(seq_str_t path, bool populate, bool hugepages,
+                             seq_int_t *size);
+SEQ_FUNC void seq_munmap(void *mem, seq_int_t size);
 
 #endif /* SEQ_LIB_H */
@@ -26,7 +26,15 @@ int main(int argc, char **argv) {
                             "print LLVM IR to stderr)"));
   opt<string> output(
       "o",
-      desc("Write LLVM bitcode to specified file instead of running with JIT"));
+      desc("Write compiled program (LLVM bitcode unless changed with -emit) "
+           "to specified file instead of running with JIT"));
+  opt<OutputKind> emit(
+      "emit", desc("Kind of output to write with -o"),
+      values(clEnumValN(BITCODE, "bc", "LLVM bitcode (default)"),
+             clEnumValN(OBJECT, "obj", "Native object file"),
+             clEnumValN(EXECUTABLE, "exe",
+                        "Native executable linked against the runtime")),
+      init(BITCODE));
   cl::list<string> libs("L", desc("Load and link the specified library"));
   cl::list<string> args(ConsumeAfter, desc("<program arguments>..."));
 
@@ -54,13 +62,13 @@ int main(int argc, char **argv) {
     argsVec.insert(argsVec.begin(), input);
     execute(s, argsVec, libsVec, debug.getValue());
   } else {
-    if (!libsVec.empty())
+    if (!libsVec.empty() && emit != EXECUTABLE)
       compilationWarning("ignoring libraries during compilation");
 
     if (!argsVec.empty())
       compilationWarning("ignoring arguments during compilation");
 
-    compile(s, output.getValue(), debug.getValue());
+    compile(s, output.getValue(), debug.getValue(), emit, libsVec);
   }
 
   return EXIT_SUCCESS;
@@ -117,14 +117,19 @@ TEST_P(SeqTest, Run) {
 
 INSTANTIATE_TEST_SUITE_P(
     CoreTests, SeqTest,
-    testing::Combine(testing::Values("core/align.seq", "core/arithmetic.seq",
-                                     "core/big.seq", "core/containers.seq",
-                                     "core/empty.seq", "core/exceptions.seq",
-                                     "core/formats.seq", "core/generators.seq",
-                                     "core/generics.seq", "core/helloworld.seq",
-                                     "core/kmers.seq", "core/match.seq",
+    testing::Combine(testing::Values("core/align.seq", "core/arena.seq",
+                                     "core/arithmetic.seq", "core/big.seq",
+                                     "core/concurrent.seq",
+                                     "core/containers.seq", "core/empty.seq",
+                                     "core/exceptions.seq", "core/extsort.seq",
+                                     "core/fmindex.seq", "core/formats.seq",
+                                     "core/gcstats.seq", "core/generators.seq",
+                                     "core/generics.seq",
+                                     "core/helloworld.seq",
+                                     "core/kmercount.seq", "core/kmers.seq",
+                                     "core/match.seq", "core/printorder.seq",
                                      "core/proteins.seq", "core/pybridge.seq",
-                                     "core/serialization.seq",
+                                     "core/serialization.seq", "core/strings.seq",
                                      "core/trees.seq"),
                      testing::Values(true, false)),
     getTestNameFromParam);